@@ -1,6 +1,6 @@
 TEMPLATE  = lib
 CONFIG   += c++14 plugin
-QT       += websockets core quick
+QT       += websockets core quick network concurrent
 
 # === Version and build information ===========================================
 # If built in Buildroot use custom package version, otherwise Git
@@ -38,6 +38,11 @@ CONFIG(debug, debug|release) {
     DEBUG_BUILD = false
 }
 
+# opt-in call, CPU time and heap growth counters: qmake CONFIG+=profiling
+CONFIG(profiling) {
+    DEFINES += HOMEASSISTANT_PROFILING
+}
+
 INTG_LIB_PATH = $$(YIO_SRC)
 isEmpty(INTG_LIB_PATH) {
     INTG_LIB_PATH = $$clean_path($$PWD/../integrations.library)
@@ -77,8 +82,34 @@ QMAKE_SUBSTITUTES += homeassistant.json.in version.txt.in
 # output path must be included for the output file from QMAKE_SUBSTITUTES
 INCLUDEPATH += $$OUT_PWD
 HEADERS  += src/homeassistant.h \
+            src/homeassistant_artwork.h \
+            src/homeassistant_decoder.h \
+            src/homeassistant_decodeworker.h \
+            src/homeassistant_dialer.h \
+            src/homeassistant_entityupdater.h \
+            src/homeassistant_jsonreader.h \
+            src/homeassistant_latency.h \
+            src/homeassistant_profiler.h \
+            src/homeassistant_remoteindex.h \
+            src/homeassistant_requests.h \
+            src/homeassistant_sendqueue.h \
+            src/homeassistant_serializer.h \
+            src/homeassistant_snapshot.h \
             src/homeassistant_supportedfeatures.h
-SOURCES  += src/homeassistant.cpp
+SOURCES  += src/homeassistant.cpp \
+            src/homeassistant_artwork.cpp \
+            src/homeassistant_decoder.cpp \
+            src/homeassistant_decodeworker.cpp \
+            src/homeassistant_dialer.cpp \
+            src/homeassistant_jsonreader.cpp \
+            src/homeassistant_latency.cpp \
+            src/homeassistant_profiler.cpp \
+            src/homeassistant_remoteindex.cpp \
+            src/homeassistant_requests.cpp \
+            src/homeassistant_sendqueue.cpp \
+            src/homeassistant_serializer.cpp \
+            src/homeassistant_snapshot.cpp \
+            src/homeassistant_supportedfeatures.cpp
 TARGET    = homeassistant
 
 # Configure destination path. DESTDIR is set in qmake-destination-path.pri
@@ -24,10 +24,15 @@
 
 #include "homeassistant.h"
 
+#include <QDir>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QtDebug>
 
+#include "homeassistant_artwork.h"
+#include "homeassistant_snapshot.h"
 #include "homeassistant_supportedfeatures.h"
 #include "math.h"
 #include "yio-interface/entities/blindinterface.h"
@@ -37,6 +42,66 @@
 #include "yio-interface/entities/remoteinterface.h"
 #include "yio-interface/entities/switchinterface.h"
 
+namespace {
+// Home Assistant services called by the command handlers
+const QString SERVICE_TOGGLE = QStringLiteral("toggle");
+const QString SERVICE_TURN_ON = QStringLiteral("turn_on");
+const QString SERVICE_TURN_OFF = QStringLiteral("turn_off");
+const QString SERVICE_OPEN_COVER = QStringLiteral("open_cover");
+const QString SERVICE_CLOSE_COVER = QStringLiteral("close_cover");
+const QString SERVICE_STOP_COVER = QStringLiteral("stop_cover");
+const QString SERVICE_SET_COVER_POSITION = QStringLiteral("set_cover_position");
+const QString SERVICE_VOLUME_SET = QStringLiteral("volume_set");
+const QString SERVICE_MEDIA_PLAY_PAUSE = QStringLiteral("media_play_pause");
+const QString SERVICE_MEDIA_PREVIOUS_TRACK = QStringLiteral("media_previous_track");
+const QString SERVICE_MEDIA_NEXT_TRACK = QStringLiteral("media_next_track");
+const QString SERVICE_SET_TEMPERATURE = QStringLiteral("set_temperature");
+const QString SERVICE_SET_HVAC_MODE = QStringLiteral("set_hvac_mode");
+const QString SERVICE_SEND_COMMAND = QStringLiteral("send_command");
+
+#ifdef HOMEASSISTANT_PROFILING
+// indexed by HomeAssistantMessage::Type
+const char *const MESSAGE_TYPE_NAMES[] = {
+    "unknown", "auth_required", "auth_ok", "auth_invalid", "result", "event", "pong",
+};
+#endif
+
+// request timeouts in ms, the state list of a large installation takes a while to arrive
+const int REQUEST_TIMEOUT = 10000;
+const int STATES_TIMEOUT = 60000;
+// time in ms the state list is processed per event loop turn
+const int STATES_SLICE_BUDGET = 10;
+// liveness timeout in ms before the round trip time was measured, and its bounds
+const int LIVENESS_TIMEOUT_INITIAL = 3000;
+const int LIVENESS_TIMEOUT_MIN = 1000;
+const int LIVENESS_TIMEOUT_MAX = 15000;
+// a command sent after this idle time in ms probes the connection
+const int PROBE_IDLE_TIME = 10000;
+// stagger time in ms between dialing the endpoints and time until all attempts are given up
+const int DIAL_STAGGER = 250;
+const int DIAL_TIMEOUT = 10000;
+// bytes handed to the socket and not yet written before the send queue holds back further messages
+const qint64 MAX_BYTES_IN_FLIGHT = 8192;
+// bytes the send queue holds before dropping the oldest messages of the lowest priority
+const qint64 MAX_QUEUED_BYTES = 65536;
+// payload bytes of a frame, QWebSocket splits longer messages
+const qint64 WEBSOCKET_FRAME_SIZE = 512 * 1024;
+
+/**
+ * @brief Bytes of a text message sent by a client: each frame has a 2 byte header, the extended payload length and
+ * a 4 byte masking key
+ */
+qint64 websocketBytes(qint64 payload) {
+    qint64 bytes = 0;
+    do {
+        qint64 frame = qMin(payload, WEBSOCKET_FRAME_SIZE);
+        bytes += 6 + (frame < 126 ? 0 : frame <= 0xFFFF ? 2 : 8) + frame;
+        payload -= frame;
+    } while (payload > 0);
+    return bytes;
+}
+}  // namespace
+
 HomeAssistantPlugin::HomeAssistantPlugin() : Plugin("yio.plugin.homeassistant", USE_WORKER_THREAD) {}
 
 Integration *HomeAssistantPlugin::createIntegration(const QVariantMap &config, EntitiesInterface *entities,
@@ -55,6 +120,13 @@ HomeAssistant::HomeAssistant(const QVariantMap &config, EntitiesInterface *entit
                              NotificationsInterface *notifications, YioAPIInterface *api, ConfigInterface *configObj,
                              Plugin *plugin)
     : Integration(config, entities, notifications, api, configObj, plugin) {
+    int     latencyLogInterval = 600000;
+    QString captureFile;
+    qint64  captureMaxSize = 10 * 1024 * 1024;
+    int     artworkSize = 400;
+    bool    decodeThread = false;
+    int     commandExpiry = 2000;
+    int     dialStagger = DIAL_STAGGER;
     for (QVariantMap::const_iterator iter = config.cbegin(); iter != config.cend(); ++iter) {
         if (iter.key() == Integration::OBJ_DATA) {
             QVariantMap map = iter.value().toMap();
@@ -62,73 +134,247 @@ HomeAssistant::HomeAssistant(const QVariantMap &config, EntitiesInterface *entit
             m_token = map.value(Integration::KEY_DATA_TOKEN).toString();
             m_ssl = map.value(Integration::KEY_DATA_SSL).toBool();
             m_ignoreSsl = map.value(Integration::KEY_DATA_SSL_IGNORE).toBool();
-            m_url = QString(m_ssl ? "wss://" : "ws://").append(m_ip).append("/api/websocket");
+            // further endpoints reach the same server, e.g. the LAN address and a TLS reverse proxy
+            QStringList endpoints = map.value("endpoints").toStringList();
+            endpoints.prepend(m_ip);
+            for (int i = 0; i < endpoints.length(); i++) {
+                QString url = EndpointDialer::websocketUrl(endpoints[i].trimmed(), m_ssl);
+                if (!endpoints[i].trimmed().isEmpty() && !m_endpoints.contains(url)) {
+                    m_endpoints.append(url);
+                }
+            }
+            dialStagger = map.value("connect_stagger", dialStagger).toInt();
+            m_compactUpdates = map.value("compact_updates", true).toBool();
+            m_sliderInterval = map.value("slider_interval", m_sliderInterval).toInt();
+            latencyLogInterval = map.value("latency_log_interval", latencyLogInterval).toInt();
+            captureFile = map.value("capture_file").toString();
+            captureMaxSize = map.value("capture_max_size", captureMaxSize).toLongLong();
+            m_stateSnapshot = map.value("state_snapshot", true).toBool();
+            decodeThread = map.value("decode_thread", decodeThread).toBool();
+            artworkSize = map.value("artwork_size", artworkSize).toInt();
+            commandExpiry = map.value("command_expiry", commandExpiry).toInt();
+            m_heartbeatCheckInterval = map.value("ping_idle_interval", m_heartbeatCheckInterval).toInt();
         }
     }
 
     qRegisterMetaType<QAbstractSocket::SocketState>();
 
-    // FIXME magic number
-    m_webSocketId = 4;
+    m_requests = new RequestTracker(this);
+    // commands waiting longer than the expiry time for a congested link are not sent anymore
+    m_sendQueue = SendQueue(MAX_QUEUED_BYTES, commandExpiry);
+
+    // frames are decoded on their own thread, the records are applied here in batches
+    if (decodeThread) {
+        m_decodeWorker = new DecodeWorker(m_logCategory, this);
+        QObject::connect(m_decodeWorker, &DecodeWorker::recordsReady, this, &HomeAssistant::onDecodedRecords);
+        QObject::connect(m_decodeWorker, &DecodeWorker::eventsLost, this, &HomeAssistant::onDecodeEventsLost);
+        m_decodeWorker->start();
+    }
+
+    // artwork is downscaled to the display size and cached on disk, 0 disables the cache. Each integration has its own
+    // directory, the size limit of its index covers all files in it.
+    if (artworkSize > 0) {
+        QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+                            "/homeassistant-artwork-" + integrationId();
+        m_artworkCache = new ArtworkCache(directory, artworkSize, 10 * 1024 * 1024, m_ignoreSsl, m_logCategory, this);
+        QObject::connect(m_artworkCache, &ArtworkCache::artworkReady, this, &HomeAssistant::onArtworkReady);
+    }
+    m_updater.setImageResolver([this](EntityInterface *entity, const QString &url, QString *imageUrl) {
+        return resolveArtwork(entity, url, imageUrl);
+    });
+
+    // the snapshot is written once the states did not change for a while
+    m_snapshotTimer = new QTimer(this);
+    m_snapshotTimer->setSingleShot(true);
+    m_snapshotTimer->setInterval(60000);
+    QObject::connect(m_snapshotTimer, &QTimer::timeout, this, &HomeAssistant::writeStateSnapshot);
+
+    if (!captureFile.isEmpty()) {
+        m_captureFile = new QFile(captureFile, this);
+        if (!m_captureFile->open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qCWarning(m_logCategory) << "Cannot open capture file" << captureFile << m_captureFile->errorString();
+            delete m_captureFile;
+            m_captureFile = nullptr;
+        } else {
+            qCInfo(m_logCategory) << "Capturing received messages to" << captureFile;
+            m_captureMaxSize = captureMaxSize;
+        }
+    }
+
+    m_latencyLogTimer = new QTimer(this);
+    m_latencyLogTimer->setInterval(latencyLogInterval);
+    QObject::connect(m_latencyLogTimer, &QTimer::timeout, this, &HomeAssistant::onLogLatency);
+    if (latencyLogInterval > 0) {
+        m_latencyLogTimer->start();
+    }
 
     m_wsReconnectTimer = new QTimer(this);
     m_wsReconnectTimer->setSingleShot(true);
     m_wsReconnectTimer->setInterval(2000);
     m_wsReconnectTimer->stop();
 
-    m_webSocket = new QWebSocket;
-    m_webSocket->setParent(this);
+    // the endpoint which won the last time is dialed first
+    QString preferred = loadPreferredEndpoint();
+    if (m_endpoints.removeOne(preferred)) {
+        m_endpoints.prepend(preferred);
+    }
+    m_url = m_endpoints.value(0);
+    m_updater.setHttpUrl(EndpointDialer::httpUrl(m_url));
 
-    QObject::connect(m_webSocket, &QWebSocket::textMessageReceived, this, &HomeAssistant::onTextMessageReceived);
-    QObject::connect(m_webSocket, static_cast<void (QWebSocket::*)(QAbstractSocket::SocketError)>(&QWebSocket::error),
-                     this, &HomeAssistant::onError);
-    QObject::connect(m_webSocket, &QWebSocket::stateChanged, this, &HomeAssistant::onStateChanged);
-    QObject::connect(m_webSocket, &QWebSocket::sslErrors, this, &HomeAssistant::onSslError);
+    m_dialer = new EndpointDialer(dialStagger, DIAL_TIMEOUT, m_logCategory, this);
+    QObject::connect(m_dialer, &EndpointDialer::connected, this, &HomeAssistant::onDialed);
+    QObject::connect(m_dialer, &EndpointDialer::failed, this, &HomeAssistant::onDialFailed);
+    QObject::connect(m_dialer, &EndpointDialer::sslErrors, this, &HomeAssistant::onSslError);
+
+    // replaced by the socket of the winning endpoint once connected
+    adoptSocket(new QWebSocket);
 
     QObject::connect(m_wsReconnectTimer, &QTimer::timeout, this, &HomeAssistant::onTimeout);
 
-    // set up timer to check heartbeat
+    // set up timer to check heartbeat, it is restarted for the remaining idle time when messages arrived
+    m_heartbeatTimer->setSingleShot(true);
     m_heartbeatTimer->setInterval(m_heartbeatCheckInterval);
     QObject::connect(m_heartbeatTimer, &QTimer::timeout, this, &HomeAssistant::onHeartbeat);
 
-    // set up hearbeat timeout timer
+    // set up hearbeat timeout timer, the interval follows the measured round trip time
     m_heartbeatTimeoutTimer->setSingleShot(true);
-    m_heartbeatTimeoutTimer->setInterval(m_heartbeatCheckInterval / 2);
     QObject::connect(m_heartbeatTimeoutTimer, &QTimer::timeout, this, &HomeAssistant::onHeartbeatTimeout);
 }
 
 void HomeAssistant::onTextMessageReceived(const QString &message) {
-    QJsonParseError parseerror;
-    QJsonDocument   doc = QJsonDocument::fromJson(message.toUtf8(), &parseerror);
-    if (parseerror.error != QJsonParseError::NoError) {
-        qCCritical(m_logCategory) << "JSON error:" << parseerror.errorString();
+    HOMEASSISTANT_PROFILE_SCOPE(&m_profiler, QStringLiteral("receive"));
+    if (m_captureFile) {
+        captureFrame(message);
+    }
+
+    // every received frame proves the connection alive, not only the pong
+    m_lastReceived.start();
+    if (m_heartbeatTimeoutTimer->isActive()) {
+        m_heartbeatTimeoutTimer->stop();
+    }
+
+    if (isUnmanagedEvent(message)) {
+        return;
+    }
+
+    if (m_decodeWorker) {
+        m_decodeWorker->push(message);
         return;
     }
-    QVariantMap map = doc.toVariant().toMap();
 
-    QString m = map.value("error").toMap().value("message").toString();
-    if (m.length() > 0) {
-        qCCritical(m_logCategory) << "Message error:" << m;
+    // messages are decoded straight from the UTF-8 frame, only the needed fields are converted
+    QByteArray                    frame = message.toUtf8();
+    QVector<HomeAssistantMessage> messages;
+    if (!HomeAssistantDecoder::decodeFrame(frame, &messages)) {
+        qCCritical(m_logCategory) << "JSON error: invalid message" << message.left(100);
+        return;
     }
 
-    QString type = map.value("type").toString();
-    int     id = map.value("id").toInt();
+    // with coalesce_messages the server batches multiple messages into one JSON array frame
+    for (int i = 0; i < messages.length(); i++) {
+        processMessage(frame, messages[i]);
+    }
+}
 
-    if (type == "auth_required") {
+void HomeAssistant::captureFrame(const QString &message) {
+    m_captureFile->write(message.toUtf8().append('\n'));
+    if (m_captureFile->pos() < m_captureMaxSize) {
+        return;
+    }
+
+    // the previous capture is kept as <file>.1, at most twice the maximum size is used
+    QString fileName = m_captureFile->fileName();
+    m_captureFile->close();
+    QFile::remove(fileName + ".1");
+    QFile::rename(fileName, fileName + ".1");
+    if (!m_captureFile->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(m_logCategory) << "Cannot open capture file" << fileName << m_captureFile->errorString();
+        delete m_captureFile;
+        m_captureFile = nullptr;
+    }
+}
+
+void HomeAssistant::onDecodedRecords() {
+    QVector<DecodedRecord> records = m_decodeWorker->takeRecords();
+    for (int i = 0; i < records.length(); i++) {
+        const DecodedRecord &record = records[i];
+        if (record.kind == DecodedRecord::MESSAGE) {
+            processMessage(record.frame, record.message);
+        } else if (record.message.id == m_subscriptionId) {
+            applyStateChange(record.change);
+        }
+    }
+}
+
+void HomeAssistant::onDecodeEventsLost() {
+    if (m_subscriptionId == 0) {
+        return;
+    }
+
+    // a new subscription replaces the events queued for the old one, the current state is fetched again
+    qCWarning(m_logCategory) << "State changes dropped by the decoder: resynchronising the entities";
+    unsubscribeFromUpdates();
+    if (m_subscribedEntities || m_statesPending) {
+        subscribeToUpdates();
+    } else {
+        synchronise(true);
+    }
+}
+
+void HomeAssistant::processMessage(const QByteArray &frame, const HomeAssistantMessage &message) {
+    HOMEASSISTANT_PROFILE_SCOPE(&m_profiler, QString("message.") + MESSAGE_TYPE_NAMES[message.type]);
+    HomeAssistantMessage::Type type = message.type;
+
+    // results are handled by the callback of their request
+    if (type == HomeAssistantMessage::RESULT || type == HomeAssistantMessage::PONG) {
+        if (!m_requests->complete(frame, message)) {
+            qCDebug(m_logCategory) << "Ignoring result of unknown or expired request" << message.id;
+        }
+        return;
+    }
+
+    if (type == HomeAssistantMessage::AUTH_REQUIRED || type == HomeAssistantMessage::AUTH_OK) {
+        m_haVersion = message.haVersion;
+    }
+
+    if (type == HomeAssistantMessage::AUTH_REQUIRED) {
+        // new connection: message ids start again at 1
+        resetRequests();
+        m_authenticated = false;
+        m_statesGeneration++;
         QString auth = QString("{ \"type\": \"auth\", \"access_token\": \"%1\" }\n").arg(m_token);
-        m_webSocket->sendTextMessage(auth);
+        writeMessage(auth);
         return;
     }
 
-    if (type == "auth_ok") {
+    if (type == HomeAssistantMessage::AUTH_OK) {
         qCInfo(m_logCategory) << "Authentication successful";
+        m_authenticated = true;
+        // entities are resolved once per connection, the received states are pushed completely after (re)connecting
+        rebuildManagedEntities();
+        m_sliderCommands.clear();
+        // let the server batch messages into array frames
+        QVariantMap features;
+        features.insert("coalesce_messages", 1);
+        QVariantMap map;
+        map.insert("type", QVariant("supported_features"));
+        map.insert("features", features);
+        sendRequest(RequestTracker::SUPPORTED_FEATURES, &map, REQUEST_TIMEOUT,
+                    [this](const RequestTracker::Result &result) {
+                        if (!result.success) {
+                            qCDebug(m_logCategory) << "Message coalescing not supported by Home Assistant"
+                                                   << m_haVersion;
+                        }
+                    });
+        recordConnectStage("authentication", m_authTimer.elapsed());
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        // FETCH STATES
+        // FETCH STATES AND SUBSCRIBE TO EVENTS IN HOME ASSISTANT
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        m_webSocket->sendTextMessage("{\"id\": 2, \"type\": \"get_states\"}\n");
+        synchronise(false);
+        return;
     }
 
-    if (type == "auth_invalid") {
+    if (type == HomeAssistantMessage::AUTH_INVALID) {
         qCCritical(m_logCategory) << "Invalid authentication";
         disconnect();
         // try again after a couple of seconds
@@ -136,66 +382,449 @@ void HomeAssistant::onTextMessageReceived(const QString &message) {
         return;
     }
 
-    // FIXME magic number!
-    if (id == 2) {
-        QVariantList list = map.value("result").toList();
-        for (int i = 0; i < list.length(); i++) {
-            QVariantMap result = list.value(i).toMap();
+    if (type == HomeAssistantMessage::EVENT && message.id == m_subscriptionId) {
+        processEvent(frame, message, m_subscribedEntities);
+    }
+}
 
-            // append the list of available entities
-            QString type = result.value("entity_id").toString().split(".")[0];
-            // rename type to match our own naming system
-            if (type == "cover") {
-                type = "blind";
-            } else if (type == "input_boolean") {
-                type = "switch";
+void HomeAssistant::processEvent(const QByteArray &frame, const HomeAssistantMessage &message, bool compressed) {
+    if (compressed) {
+        QVector<EntityStateChange> changes;
+        if (!HomeAssistantDecoder::decodeCompressedStatesEvent(frame, message.event, &changes)) {
+            qCWarning(m_logCategory) << "Invalid subscribe_entities event";
+        }
+        for (int i = 0; i < changes.length(); i++) {
+            applyStateChange(changes[i]);
+        }
+    } else {
+        // events of other entities are skipped by the decoder before their state is decoded
+        EntityStateChange change;
+        if (HomeAssistantDecoder::decodeStateChangedEvent(frame, message.event, &change, &m_managedEntityIds)) {
+            applyStateChange(change);
+        }
+    }
+}
+
+void HomeAssistant::synchronise(bool resync) {
+    // the subscription is requested first, its result does not wait for the state list to be serialized
+    m_statesResync = resync;
+    m_statesPending = true;
+    m_earlyChanges.clear();
+    subscribeToUpdates();
+
+    QVariantMap map;
+    map.insert("type", QVariant("get_states"));
+    sendRequest(RequestTracker::GET_STATES, &map, STATES_TIMEOUT,
+                [this](const RequestTracker::Result &result) { onStatesReceived(result); });
+}
+
+void HomeAssistant::onStatesReceived(const RequestTracker::Result &result) {
+    if (result.dropped) {
+        // the connection was reset, the states are fetched again on the next one
+        return;
+    }
+    if (result.timedOut) {
+        qCWarning(m_logCategory) << "Fetching the states timed out: reconnecting";
+        m_webSocket->close();
+        return;
+    }
+
+    // the list is processed in slices, a previous synchronisation still in progress is abandoned
+    m_statesGeneration++;
+    m_availableEntities.clear();
+    m_registeredEntities = 0;
+    m_statesCount = 0;
+    m_unchangedEntities = 0;
+    recordConnectStage("states", result.elapsed);
+
+    JsonReader reader(*result.frame, result.message->result);
+    if (!result.success || !reader.beginArray()) {
+        qCCritical(m_logCategory) << "Fetching the states failed:" << result.errorMessage;
+        m_statesFrame.clear();
+        applyEarlyChanges();
+        return;
+    }
+    m_statesFrame = *result.frame;
+    m_statesPosition = reader.position();
+    m_statesTimer.start();
+    processStatesSlice(m_statesGeneration);
+}
+
+void HomeAssistant::processStatesSlice(int generation) {
+    if (generation != m_statesGeneration || !m_webSocket->isValid()) {
+        return;
+    }
+
+    QElapsedTimer budget;
+    budget.start();
+    JsonReader reader(m_statesFrame, m_statesPosition);
+    while (!budget.hasExpired(STATES_SLICE_BUDGET)) {
+        if (!reader.nextElement()) {
+            if (reader.hasError()) {
+                qCWarning(m_logCategory) << "Invalid get_states result";
+            } else if (!m_statesResync) {
+                reportRemovedEntities(generation);
             }
-            // add entity to allAvailableEntities list
-            addAvailableEntity(
-                result.value("entity_id").toString(), type, integrationId(),
-                result.value("attributes").toMap().value("friendly_name").toString(),
-                supportedFeatures(type, result.value("attributes").toMap().value("supported_features").toInt()));
+            qCDebug(m_logCategory) << "Received the states of" << m_statesCount << "entities in"
+                                   << m_statesTimer.elapsed() << "ms";
+            // release the payload, the available entities are registered in the following slices
+            m_statesFrame.clear();
+            recordConnectStage("states_applied", m_statesTimer.elapsed());
+            applyEarlyChanges();
+            if (!m_statesResync) {
+                QTimer::singleShot(0, this, [this, generation]() { registerAvailableEntities(generation); });
+            }
+            return;
+        }
+
+        EntityState state;
+        HomeAssistantDecoder::decodeState(&reader, &state);
 
-            // update the entity
-            updateEntity(result.value("entity_id").toString(), result);
+        // update the entity, only the configured entities have an update handler
+        updateEntity(state);
+        m_statesCount++;
+        if (m_statesResync) {
+            continue;
         }
 
-        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        // SUBSCRIBE TO EVENTS IN HOME ASSISTANT
-        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        m_webSocket->sendTextMessage(
-            "{\"id\": 3, \"type\": \"subscribe_events\", \"event_type\": \"state_changed\"}\n");
+        // only entities which are new or changed since the last synchronisation are registered again
+        QStringRef domain = state.entityId.leftRef(state.entityId.indexOf('.'));
+        int        features = state.supportedFeatures;
+        if (domain == QLatin1String("climate")) {
+            features |= state.hvacModes << HvacModes::HVAC_MODES_SHIFT;
+        }
+        uint          signature = qHash(state.friendlyName, qHash(domain, static_cast<uint>(features)));
+        Registration &registration = m_registrations[state.entityId];
+        registration.generation = generation;
+        if (registration.registered && registration.signature == signature) {
+            m_unchangedEntities++;
+            continue;
+        }
+
+        // append the list of available entities
+        AvailableEntity available;
+        available.entityId = state.entityId;
+        available.type = domain.toString();
+        // rename type to match our own naming system
+        if (available.type == "cover") {
+            available.type = "blind";
+        } else if (available.type == "input_boolean") {
+            available.type = "switch";
+        }
+        available.friendlyName = state.friendlyName;
+        available.supportedFeatures = features;
+        available.signature = signature;
+        m_availableEntities.append(available);
+    }
+
+    // continue in the next event loop turn so commands and other messages are not blocked
+    m_statesPosition = reader.position();
+    QTimer::singleShot(0, this, [this, generation]() { processStatesSlice(generation); });
+}
+
+void HomeAssistant::applyEarlyChanges() {
+    // events received while the state list was fetched, older states than the fetched ones are skipped by their
+    // last_updated time
+    m_statesPending = false;
+    QVector<EntityStateChange> changes;
+    changes.swap(m_earlyChanges);
+    if (!changes.isEmpty()) {
+        qCDebug(m_logCategory) << "Applying" << changes.length() << "state changes received during synchronisation";
+    }
+    for (int i = 0; i < changes.length(); i++) {
+        applyStateChange(changes[i]);
+    }
+    completeConnection();
+}
+
+void HomeAssistant::reportRemovedEntities(int generation) {
+    // registered entities which were not part of this state list
+    QStringList removed;
+    for (QHash<QString, Registration>::iterator iter = m_registrations.begin(); iter != m_registrations.end();) {
+        if (iter->generation != generation) {
+            removed.append(iter.key());
+            iter = m_registrations.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    if (!removed.isEmpty()) {
+        qCInfo(m_logCategory) << removed.length() << "available entities were removed from Home Assistant:" << removed;
+    }
+    m_lastRegistration.insert("removed", removed);
+}
+
+void HomeAssistant::registerAvailableEntities(int generation) {
+    if (generation != m_statesGeneration) {
+        return;
+    }
+
+    QElapsedTimer budget;
+    budget.start();
+    while (m_registeredEntities < m_availableEntities.length()) {
+        if (budget.hasExpired(STATES_SLICE_BUDGET)) {
+            QTimer::singleShot(0, this, [this, generation]() { registerAvailableEntities(generation); });
+            return;
+        }
+        // add entity to allAvailableEntities list
+        const AvailableEntity &available = m_availableEntities[m_registeredEntities++];
+        addAvailableEntity(available.entityId, available.type, integrationId(), available.friendlyName,
+                           m_featureMapper.features(available.type, available.supportedFeatures));
+        Registration &registration = m_registrations[available.entityId];
+        registration.signature = available.signature;
+        registration.registered = true;
+    }
+
+    qCDebug(m_logCategory) << "Registered" << m_availableEntities.length() << "new or changed available entities,"
+                           << m_unchangedEntities << "unchanged, in" << m_statesTimer.elapsed() << "ms";
+    m_lastRegistration.insert("registered", m_availableEntities.length());
+    m_lastRegistration.insert("unchanged", m_unchangedEntities);
+    m_availableEntities.clear();
+    m_availableEntities.squeeze();
+    m_registeredEntities = 0;
+}
+
+void HomeAssistant::onSubscribed(const RequestTracker::Result &result) {
+    if (result.dropped) {
+        // the connection was reset, the next one subscribes again
+        return;
+    }
+    if (!result.success && !result.timedOut && m_subscribedEntities) {
+        // older server without subscribe_entities support: fall back to the full state_changed events
+        qCWarning(m_logCategory) << "subscribe_entities not supported by Home Assistant" << m_haVersion
+                                 << ": falling back to state_changed events";
+        m_compactUpdates = false;
+        subscribeToUpdates();
+        return;
+    }
+    if (!result.success) {
+        qCCritical(m_logCategory) << "Subscribing to state changes failed:" << result.errorMessage;
+        m_webSocket->close();
+        return;
+    }
+
+    if (m_standby) {
+        // reconnected while in standby: connected without updates, leaveStandby subscribes again
+        unsubscribeFromUpdates();
+        completeConnection();
+        return;
+    }
+
+    qCDebug(m_logCategory) << "Subscribed to state changes";
+    recordConnectStage("subscription", result.elapsed);
+    m_subscriptionConfirmed = true;
+    completeConnection();
+}
+
+void HomeAssistant::completeConnection() {
+    // connected once both the subscription and the state list of the pipelined synchronisation are done. In standby
+    // the subscription is dropped as soon as it is confirmed.
+    bool subscribed = m_subscriptionConfirmed || (m_standby && m_subscriptionId == 0);
+    if (!subscribed || m_statesPending) {
+        return;
     }
 
-    // FIXME magic number!
-    if (type == "result" && id == 3) {
-        setState(CONNECTED);
-        qCDebug(m_logCategory) << "Subscribed to state changes";
+    setState(CONNECTED);
+    if (m_connectTimer.isValid()) {
+        qCInfo(m_logCategory) << "Connected in" << m_connectTimer.elapsed() << "ms";
+        recordConnectStage("connected", m_connectTimer.elapsed());
+        m_connectTimer.invalidate();
+    }
+    // entities still showing their snapshot state are unknown to Home Assistant: they are shown as unavailable and
+    // the user is told how many there are
+    if (!m_staleNotification.isEmpty()) {
+        m_notifications->remove(m_staleNotification);
+        m_staleNotification.clear();
+    }
+    if (!m_staleEntities.isEmpty()) {
+        markStaleEntities();
+        m_staleNotification = tr("%1: %2 entities unknown to Home Assistant.")
+                                  .arg(friendlyName(), QString::number(m_staleEntities.size()));
+        m_notifications->add(false, m_staleNotification);
+    }
 
-        // remove notifications that we don't need anymore as the integration is connected
-        m_notifications->remove("Cannot connect to Home Assistant.");
+    // remove notifications that we don't need anymore as the integration is connected
+    m_notifications->remove("Cannot connect to Home Assistant.");
 
+    if (!m_standby) {
         m_heartbeatTimer->start();
     }
+}
+
+void HomeAssistant::subscribeToUpdates() {
+    QStringList entityIds = m_managedEntityIds.values();
+    m_entityStates.clear();
+    m_subscriptionConfirmed = false;
+    m_subscribedEntities = m_compactUpdates && !entityIds.isEmpty() && supportsSubscribeEntities(m_haVersion);
 
-    if (id == m_webSocketId) {
-        qCDebug(m_logCategory) << "Command successful";
+    QVariantMap map;
+    if (m_subscribedEntities) {
+        // only the configured entities: initial state followed by compact add / change / remove diffs
+        map.insert("type", QVariant("subscribe_entities"));
+        map.insert("entity_ids", QVariant(entityIds));
+        qCDebug(m_logCategory) << "Subscribing to compact state updates of" << entityIds.length() << "entities";
+    } else {
+        map.insert("type", QVariant("subscribe_events"));
+        map.insert("event_type", QVariant("state_changed"));
     }
+    // the subscription id and the event frame prefix are set once the request is sent
+    sendRequest(RequestTracker::SUBSCRIBE, &map, REQUEST_TIMEOUT,
+                [this](const RequestTracker::Result &result) { onSubscribed(result); });
+}
 
-    // FIXME magic number!
-    if (type == "event" && id == 3) {
-        QVariantMap data = map.value("event").toMap().value("data").toMap();
-        QVariantMap newState = data.value("new_state").toMap();
-        updateEntity(data.value("entity_id").toString(), newState);
+void HomeAssistant::unsubscribeFromUpdates() {
+    if (m_subscriptionId == 0) {
+        return;
     }
+    QVariantMap map;
+    map.insert("type", QVariant("unsubscribe_events"));
+    map.insert("subscription", QVariant(m_subscriptionId));
+    sendRequest(RequestTracker::UNSUBSCRIBE, &map, REQUEST_TIMEOUT, [this](const RequestTracker::Result &result) {
+        if (!result.success) {
+            qCWarning(m_logCategory) << "Unsubscribing from state changes failed:" << result.errorMessage;
+        }
+    });
+    // events still arriving for the old subscription are ignored
+    m_subscriptionId = 0;
+    m_subscriptionConfirmed = false;
+    m_eventFramePrefix.clear();
+}
 
-    // heartbeat
-    if (type == "pong") {
-        qCDebug(m_logCategory) << "Got heartbeat!";
-        m_heartbeatTimeoutTimer->stop();
+void HomeAssistant::applyStateChange(const EntityStateChange &change) {
+    if (m_statesPending) {
+        // held back until the fetched states are applied
+        m_earlyChanges.append(change);
+        return;
+    }
+
+    const QString &entityId = change.state.entityId;
+    if (!m_awaitedStateChanges.isEmpty()) {
+        recordStateLatency(entityId);
+    }
+
+    switch (change.kind) {
+        case EntityStateChange::ADDED:
+            // complete state: initial subscribe_entities state or state_changed event
+            if (m_subscribedEntities) {
+                m_entityStates.insert(entityId, change.state);
+            }
+            updateEntity(change.state);
+            break;
+        case EntityStateChange::CHANGED: {
+            // compact diff which has to be applied to the last known state
+            QHash<QString, EntityState>::iterator iter = m_entityStates.find(entityId);
+            if (iter == m_entityStates.end()) {
+                qCWarning(m_logCategory) << "Ignoring state diff of unknown entity" << entityId;
+                break;
+            }
+            iter->merge(change.state);
+            iter->remove(change.removedFields);
+            updateEntity(*iter);
+            break;
+        }
+        case EntityStateChange::REMOVED: {
+            m_entityStates.remove(entityId);
+            EntityState removed;
+            removed.entityId = entityId;
+            updateEntity(removed);
+            break;
+        }
     }
 }
 
+void HomeAssistant::rebuildManagedEntities() {
+    QHash<QString, ManagedEntity> previous;
+    previous.swap(m_managedEntities);
+    m_managedEntityIds.clear();
+    m_remoteIndex.clear();
+    QList<EntityInterface *> entities = m_entities->getByIntegration(integrationId());
+    for (int i = 0; i < entities.length(); i++) {
+        addManagedEntity(entities[i])->lastState = previous.value(entities[i]->entity_id()).lastState;
+    }
+
+    if (m_decodeWorker) {
+        m_decodeWorker->setEntityFilter(m_managedEntityIds);
+    }
+}
+
+QHash<QString, HomeAssistant::ManagedEntity>::iterator HomeAssistant::addManagedEntity(EntityInterface *entity) {
+    ManagedEntity managed;
+    managed.entity = entity;
+    managed.type = entityTypeOf(entity->type());
+    // remote entities are configured as <entity_id>+<device>
+    QString entityId = entity->entity_id();
+    managed.haEntityId = entityId.left(entityId.indexOf('+'));
+    managed.haDomain = managed.haEntityId.left(managed.haEntityId.indexOf('.'));
+    m_managedEntityIds.insert(managed.haEntityId);
+
+    if (managed.type == REMOTE) {
+        RemoteInterface *remoteInterface = static_cast<RemoteInterface *>(entity->getSpecificInterface());
+        m_remoteIndex[entityId].build(remoteInterface->commands());
+    }
+    return m_managedEntities.insert(entityId, managed);
+}
+
+void HomeAssistant::onManagedEntityAdded() {
+    if (m_decodeWorker) {
+        m_decodeWorker->setEntityFilter(m_managedEntityIds);
+    }
+    // the compact subscription only contains the entity ids it was requested with, its initial state brings the
+    // current state of the added entity. The state_changed subscription covers all entities already.
+    if (m_subscribedEntities && m_subscriptionId != 0) {
+        qCDebug(m_logCategory) << "Resubscribing with the entity added after connecting";
+        unsubscribeFromUpdates();
+        subscribeToUpdates();
+    }
+}
+
+HomeAssistant::EntityType HomeAssistant::entityTypeOf(const QString &type) {
+    if (type == "light") {
+        return LIGHT;
+    } else if (type == "blind") {
+        return BLIND;
+    } else if (type == "media_player") {
+        return MEDIA_PLAYER;
+    } else if (type == "climate") {
+        return CLIMATE;
+    } else if (type == "switch") {
+        return SWITCH;
+    } else if (type == "remote") {
+        return REMOTE;
+    }
+    return UNSUPPORTED;
+}
+
+bool HomeAssistant::isUnmanagedEvent(const QString &message) const {
+    // only single state_changed events are checked, the compact subscription is already filtered by the server
+    if (m_subscribedEntities || m_eventFramePrefix.isEmpty() || !message.startsWith(m_eventFramePrefix)) {
+        return false;
+    }
+
+    // the first entity_id of a state_changed event is the one of its data object
+    static const QLatin1String ENTITY_ID_KEY("\"entity_id\":\"");
+    int                        start = message.indexOf(ENTITY_ID_KEY, m_eventFramePrefix.length());
+    if (start < 0) {
+        return false;
+    }
+    start += ENTITY_ID_KEY.size();
+    int end = message.indexOf('"', start);
+    if (end < 0) {
+        return false;
+    }
+    return !m_managedEntityIds.contains(message.mid(start, end - start));
+}
+
+bool HomeAssistant::supportsSubscribeEntities(const QString &haVersion) {
+    // subscribe_entities was introduced with Home Assistant 2022.4, the version format is YEAR.MONTH.PATCH[suffix]
+    QStringList parts = haVersion.split('.');
+    if (parts.length() < 2) {
+        return false;
+    }
+    int year = parts[0].toInt();
+    int month = parts[1].toInt();
+    return year > 2022 || (year == 2022 && month >= 4);
+}
+
 void HomeAssistant::onStateChanged(QAbstractSocket::SocketState state) {
     if (state == QAbstractSocket::UnconnectedState && !m_userDisconnect) {
         qCDebug(m_logCategory) << "State changed to 'Unconnected': starting reconnect";
@@ -203,6 +832,7 @@ void HomeAssistant::onStateChanged(QAbstractSocket::SocketState state) {
         // turn off heartbeat
         m_heartbeatTimer->stop();
         m_heartbeatTimeoutTimer->stop();
+        resetRequests();
 
         if (m_webSocket->isValid()) {
             m_webSocket->close();
@@ -218,6 +848,7 @@ void HomeAssistant::onError(QAbstractSocket::SocketError error) {
     // turn off heartbeat
     m_heartbeatTimer->stop();
     m_heartbeatTimeoutTimer->stop();
+    resetRequests();
 
     if (m_webSocket->isValid()) {
         m_webSocket->close();
@@ -230,7 +861,7 @@ void HomeAssistant::onTimeout() {
     if (m_tries == 3) {
         disconnect();
 
-        qCCritical(m_logCategory) << "Cannot connect to Home Assistant: retried 3 times connecting to" << m_ip;
+        qCCritical(m_logCategory) << "Cannot connect to Home Assistant: retried 3 times connecting to" << m_endpoints;
         QObject *param = this;
 
         m_notifications->add(
@@ -243,23 +874,24 @@ void HomeAssistant::onTimeout() {
 
         m_tries = 0;
     } else {
-        // FIXME magic number
-        m_webSocketId = 4;
         if (m_state != CONNECTING) {
             setState(CONNECTING);
         }
 
-        qCDebug(m_logCategory) << "Reconnection attempt" << m_tries + 1 << "to HomeAssistant server:" << m_url;
-        m_webSocket->open(QUrl(m_url));
+        qCDebug(m_logCategory) << "Reconnection attempt" << m_tries + 1 << "to HomeAssistant server";
+        m_connectTimer.start();
+        m_dialer->dial(m_endpoints);
 
         m_tries++;
     }
 }
 
-void HomeAssistant::onSslError(QList<QSslError>) {
+void HomeAssistant::onSslError(QWebSocket *socket, const QList<QSslError> &errors) {
+    Q_UNUSED(errors)
+    // the socket is the one of a dial attempt while connecting, not m_webSocket
     if (m_ignoreSsl) {
         qCDebug(m_logCategory) << "Ignoring SSL errors.";
-        m_webSocket->ignoreSslErrors();
+        socket->ignoreSslErrors();
     } else {
         qCWarning(m_logCategory) << "SSL certificate error";
         m_notifications->add(
@@ -268,206 +900,431 @@ void HomeAssistant::onSslError(QList<QSslError>) {
     }
 }
 
-void HomeAssistant::webSocketSendCommand(const QString &domain, const QString &service, const QString &entityId,
-                                         QVariantMap *data) {
-    // sends a command to home assistant
-    m_webSocketId++;
+CommandSerializer *HomeAssistant::beginCommand(const ManagedEntity &entity, const QString &service) {
+    m_serializer.begin(entity.haDomain, service, entity.haEntityId);
+    return &m_serializer;
+}
+
+void HomeAssistant::webSocketSendCommand(const ManagedEntity &entity, const QString &service,
+                                         const RequestTracker::Callback &callback) {
+    beginCommand(entity, service);
+    sendCommandMessage(callback);
+}
 
-    QVariantMap map;
-    map.insert("id", QVariant(m_webSocketId));
-    map.insert("type", QVariant("call_service"));
-    map.insert("domain", QVariant(domain));
-    map.insert("service", QVariant(service));
-
-    if (data == nullptr) {
-        QVariantMap d;
-        d.insert("entity_id", QVariant(entityId));
-        map.insert("service_data", d);
+void HomeAssistant::sendCommandMessage(const RequestTracker::Callback &next) {
+    // sends the command written with beginCommand to home assistant
+    HOMEASSISTANT_PROFILE_SCOPE(&m_profiler, QString("send.") + m_serializer.domain());
+    const QString &service = m_serializer.serviceName();
+    const QString &entityId = m_serializer.entityId();
+
+    // the first state change after the oldest unanswered command of the entity is attributed to it
+    if (!m_awaitedStateChanges.contains(entityId)) {
+        AwaitedStateChange &awaited = m_awaitedStateChanges[entityId];
+        awaited.service = service;
+        awaited.sent.start();
+    }
+
+    // a slider command waits for the result of its previous value
+    RequestTracker::Callback callback = [this](const RequestTracker::Result &result) { onCommandResult(result); };
+    if (next) {
+        callback = [this, next](const RequestTracker::Result &result) {
+            onCommandResult(result);
+            next(result);
+        };
+    }
+
+    // a command on a connection idle for long probes it, a dead link is noticed before the user retries
+    if (m_lastReceived.isValid() && m_lastReceived.hasExpired(PROBE_IDLE_TIME)) {
+        sendPing();
+    }
+
+    if (m_sendQueue.isEmpty() && m_bytesInFlight < MAX_BYTES_IN_FLIGHT && m_webSocket->isValid()) {
+        // nothing waiting and the link keeps up: sent straight from the serializer
+        sendMessage(&m_serializer.finish(), RequestTracker::CALL_SERVICE, entityId, service, REQUEST_TIMEOUT, callback);
+        return;
+    }
+
+    SendQueue::Message message;
+    message.priority = SendQueue::INTERACTIVE;
+    message.body = m_serializer.finish();
+    message.entityId = entityId;
+    message.service = service;
+    message.timeout = REQUEST_TIMEOUT;
+    message.callback = callback;
+    enqueueMessage(message);
+}
+
+void HomeAssistant::sendRequest(RequestTracker::Kind kind, QVariantMap *message, int timeout,
+                                const RequestTracker::Callback &callback, const QString &entityId) {
+    SendQueue::Message queued;
+    queued.priority = kind == RequestTracker::PING ? SendQueue::HEARTBEAT : SendQueue::RESYNC;
+    queued.kind = kind;
+    queued.entityId = entityId;
+    queued.timeout = timeout;
+    queued.callback = callback;
+
+    // the id is the last member, it is appended once the message is sent
+    queued.body = QString::fromUtf8(QJsonDocument::fromVariant(*message).toJson(QJsonDocument::JsonFormat::Compact));
+    queued.body.chop(1);
+    queued.body.append(message->isEmpty() ? QLatin1String("\"id\":") : QLatin1String(",\"id\":"));
+    enqueueMessage(queued);
+}
+
+void HomeAssistant::enqueueMessage(const SendQueue::Message &message) {
+    QList<SendQueue::Message> dropped = m_sendQueue.enqueue(message);
+    for (int i = 0; i < dropped.length(); i++) {
+        failMessage(dropped[i], "Dropped from the full send queue");
+    }
+    flushSendQueue();
+}
+
+void HomeAssistant::flushSendQueue() {
+    QList<SendQueue::Message> expired;
+    SendQueue::Message        message;
+    while (m_bytesInFlight < MAX_BYTES_IN_FLIGHT && m_webSocket->isValid() &&
+           m_sendQueue.takeNext(&message, &expired)) {
+        sendMessage(&message.body, message.kind, message.entityId, message.service, message.timeout, message.callback);
+    }
+    // callbacks may send new requests, they are called once the queue is consistent
+    for (int i = 0; i < expired.length(); i++) {
+        failMessage(expired[i], "Expired in the send queue");
+    }
+}
+
+void HomeAssistant::sendMessage(QString *body, RequestTracker::Kind kind, const QString &entityId,
+                                const QString &service, int timeout, const RequestTracker::Callback &callback) {
+    // ids are assigned in sending order, Home Assistant rejects ids which are not increasing
+    int id = m_requests->nextId();
+    m_requests->track(id, kind, entityId, service, timeout, callback);
+    CommandSerializer::appendInt(body, id);
+    body->append('}');
+    if (kind == RequestTracker::SUBSCRIBE) {
+        m_subscriptionId = id;
+        m_eventFramePrefix = QString("{\"id\":%1,\"type\":\"event\"").arg(id);
+    }
+    writeMessage(*body);
+}
+
+void HomeAssistant::failMessage(const SendQueue::Message &message, const QString &errorMessage) {
+    qCWarning(m_logCategory) << "Request" << message.kind << message.service << message.entityId << "not sent:"
+                             << errorMessage;
+    if (!message.callback) {
+        return;
+    }
+    RequestTracker::Request request;
+    request.kind = message.kind;
+    request.entityId = message.entityId;
+    request.service = message.service;
+    request.sent = message.queued;
+    request.timeout = message.timeout;
+
+    RequestTracker::Result result;
+    result.request = &request;
+    result.dropped = true;
+    result.errorMessage = errorMessage;
+    result.elapsed = message.queued.elapsed();
+    message.callback(result);
+}
+
+void HomeAssistant::writeMessage(const QString &message) {
+    // sendTextMessage returns the payload bytes, bytesWritten reports the frames
+    qint64 payload = m_webSocket->sendTextMessage(message);
+    if (payload >= 0) {
+        m_bytesInFlight += websocketBytes(payload);
+    }
+}
+
+void HomeAssistant::onBytesWritten(qint64 bytes) {
+    m_bytesInFlight -= bytes;
+    if (!m_sendQueue.isEmpty()) {
+        flushSendQueue();
+    }
+}
+
+void HomeAssistant::resetRequests() {
+    // slider values are not carried over to the next connection
+    m_sliderCommands.clear();
+    QList<SendQueue::Message> queued = m_sendQueue.clear();
+    m_bytesInFlight = 0;
+
+    // callbacks may send new requests, they are called once the tracker and the queue are reset
+    m_requests->reset("Connection reset");
+    for (int i = 0; i < queued.length(); i++) {
+        failMessage(queued[i], "Connection reset");
+    }
+}
+
+void HomeAssistant::onCommandResult(const RequestTracker::Result &result) {
+    const RequestTracker::Request *request = result.request;
+    const QString                 &service = request->service;
+    if (result.success) {
+        qCDebug(m_logCategory) << "Command successful:" << service << request->entityId << result.elapsed << "ms";
+        m_resultLatency[service].record(result.elapsed);
+    } else if (result.timedOut) {
+        qCWarning(m_logCategory) << "Command timed out:" << service << request->entityId;
     } else {
-        data->insert("entity_id", QVariant(entityId));
-        map.insert("service_data", *data);
+        qCWarning(m_logCategory) << "Command failed:" << service << request->entityId << result.errorMessage;
     }
-    QJsonDocument doc = QJsonDocument::fromVariant(map);
-    QString       message = doc.toJson(QJsonDocument::JsonFormat::Compact);
-    m_webSocket->sendTextMessage(message);
 }
 
-int HomeAssistant::convertBrightnessToPercentage(float value) {
-    return static_cast<int>(round(value / 255 * 100));
+HomeAssistant::UpdateHandler HomeAssistant::updateHandlerOf(EntityType type) {
+    // indexed by EntityType
+    static const UpdateHandler UPDATE_HANDLERS[] = {
+        &EntityUpdater<EntityInterface>::updateLight,   &EntityUpdater<EntityInterface>::updateBlind,
+        &EntityUpdater<EntityInterface>::updateMediaPlayer, &EntityUpdater<EntityInterface>::updateClimate,
+        &EntityUpdater<EntityInterface>::updateSwitch,  nullptr,
+        nullptr};
+    return UPDATE_HANDLERS[type];
 }
 
-void HomeAssistant::updateEntity(const QString &entity_id, const QVariantMap &attr) {
-    EntityInterface *entity = m_entities->getEntityInterface(entity_id);
-    if (entity) {
-        if (entity->type() == "light") {
-            updateLight(entity, attr);
-        }
-        if (entity->type() == "blind") {
-            updateBlind(entity, attr);
+void HomeAssistant::updateEntity(const EntityState &attr) {
+    QHash<QString, ManagedEntity>::iterator iter = m_managedEntities.find(attr.entityId);
+    if (iter == m_managedEntities.end()) {
+        return;
+    }
+    UpdateHandler handler = updateHandlerOf(iter->type);
+    if (handler) {
+        // the fetched states and the events of the subscription overlap while synchronising
+        if (attr.has(EntityState::LAST_UPDATED) && iter->lastState.has(EntityState::LAST_UPDATED) &&
+            attr.lastUpdated < iter->lastState.lastUpdated) {
+            m_outdatedUpdates++;
+            return;
         }
-        if (entity->type() == "media_player") {
-            updateMediaPlayer(entity, attr);
+        {
+            HOMEASSISTANT_PROFILE_SCOPE(&m_profiler, QString("update.") + iter->haDomain);
+            (m_updater.*handler)(iter->entity, attr, &iter->snapshot);
         }
-        if (entity->type() == "climate") {
-            updateClimate(entity, attr);
+
+        // confirmed by Home Assistant, kept for the next state snapshot
+        iter->lastState = attr;
+        if (m_staleEntities.remove(attr.entityId) && m_staleEntities.isEmpty() && !m_staleNotification.isEmpty()) {
+            m_notifications->remove(m_staleNotification);
+            m_staleNotification.clear();
         }
-        if (entity->type() == "switch") {
-            updateSwitch(entity, attr);
+        if (m_stateSnapshot && !m_snapshotTimer->isActive()) {
+            m_snapshotTimer->start();
         }
     }
 }
 
-void HomeAssistant::updateLight(EntityInterface *entity, const QVariantMap &attr) {
-    // state
-    if (attr.value("state").toString() == "on") {
-        entity->setState(LightDef::ON);
-    } else {
-        entity->setState(LightDef::OFF);
+QString HomeAssistant::stateSnapshotFile() {
+    QString path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(path);
+    return path + "/homeassistant-" + integrationId() + ".snapshot";
+}
+
+void HomeAssistant::applyStateSnapshot() {
+    QElapsedTimer timer;
+    timer.start();
+    QVector<EntityState> states;
+    if (!StateSnapshot::read(stateSnapshotFile(), &states)) {
+        return;
     }
 
-    QVariantMap haAttr = attr.value("attributes").toMap();
-    // brightness
-    if (entity->isSupported(LightDef::F_BRIGHTNESS)) {
-        if (haAttr.contains("brightness")) {
-            entity->updateAttrByIndex(LightDef::BRIGHTNESS,
-                                      convertBrightnessToPercentage(haAttr.value("brightness").toInt()));
-        } else {
-            entity->updateAttrByIndex(LightDef::BRIGHTNESS, 0);
+    rebuildManagedEntities();
+    for (int i = 0; i < states.length(); i++) {
+        if (!m_managedEntities.contains(states[i].entityId)) {
+            continue;
         }
+        updateEntity(states[i]);
+        // stale until Home Assistant sends the current state
+        m_staleEntities.insert(states[i].entityId);
     }
+    m_snapshotTimer->stop();
+    qCDebug(m_logCategory) << "Applied state snapshot of" << m_staleEntities.size() << "entities in"
+                           << timer.elapsed() << "ms";
+}
 
-    // color
-    if (entity->isSupported(LightDef::F_COLOR)) {
-        QVariant     color = haAttr.value("rgb_color");
-        QVariantList cl(color.toList());
-        char         buffer[10];
-        snprintf(buffer, sizeof(buffer), "#%02X%02X%02X", cl.value(0).toInt(), cl.value(1).toInt(),
-                 cl.value(2).toInt());
-        entity->updateAttrByIndex(LightDef::COLOR, buffer);
-    }
+void HomeAssistant::markStaleEntities() {
+    QStringList stale = m_staleEntities.values();
+    stale.sort();
+    qCWarning(m_logCategory) << stale.length() << "entities of the state snapshot are unknown to Home Assistant";
+    qCDebug(m_logCategory) << "Unknown entities:" << stale;
 
-    // color temp
-    if (entity->isSupported(LightDef::F_COLORTEMP)) {
-        // FIXME implement me!
+    for (int i = 0; i < stale.length(); i++) {
+        QHash<QString, ManagedEntity>::iterator iter = m_managedEntities.find(stale[i]);
+        if (iter == m_managedEntities.end() || !updateHandlerOf(iter->type)) {
+            continue;
+        }
+        EntityState unavailable;
+        unavailable.fields = EntityState::STATE;
+        unavailable.entityId = stale[i];
+        unavailable.state = "unavailable";
+        (m_updater.*updateHandlerOf(iter->type))(iter->entity, unavailable, &iter->snapshot);
+        // neither confirmed nor kept for the next snapshot, the first live update pushes every attribute again
+        iter->snapshot = EntitySnapshot();
+        iter->lastState = EntityState();
     }
 }
 
-void HomeAssistant::updateBlind(EntityInterface *entity, const QVariantMap &attr) {
-    QVariantMap attributes;
+void HomeAssistant::writeStateSnapshot() {
+    m_snapshotTimer->stop();
 
-    // state
-    if (attr.value("state").toString() == "open") {
-        entity->setState(BlindDef::OPEN);
-    } else {
-        entity->setState(BlindDef::CLOSED);
+    QVector<EntityState> states;
+    states.reserve(m_managedEntities.size());
+    for (QHash<QString, ManagedEntity>::const_iterator iter = m_managedEntities.cbegin();
+         iter != m_managedEntities.cend(); ++iter) {
+        if (iter->lastState.fields != 0) {
+            states.append(iter->lastState);
+        }
     }
-
-    // position
-    if (entity->isSupported(BlindDef::F_POSITION)) {
-        entity->updateAttrByIndex(BlindDef::POSITION,
-                                  100 - attr.value("attributes").toMap().value("current_position").toInt());
+    if (states.isEmpty()) {
+        return;
+    }
+    if (!StateSnapshot::write(stateSnapshotFile(), states)) {
+        qCWarning(m_logCategory) << "Cannot write the state snapshot" << stateSnapshotFile();
     }
 }
 
-void HomeAssistant::updateMediaPlayer(EntityInterface *entity, const QVariantMap &attr) {
-    // state
-    QString state = attr.value("state").toString();
-    if (state == "off") {
-        entity->updateAttrByIndex(MediaPlayerDef::STATE, MediaPlayerDef::OFF);
-    } else if (state == "on") {
-        entity->updateAttrByIndex(MediaPlayerDef::STATE, MediaPlayerDef::ON);
-    } else if (state == "idle") {
-        entity->updateAttrByIndex(MediaPlayerDef::STATE, MediaPlayerDef::IDLE);
-    } else if (state == "playing") {
-        entity->updateAttrByIndex(MediaPlayerDef::STATE, MediaPlayerDef::PLAYING);
-    } else {
-        entity->updateAttrByIndex(MediaPlayerDef::STATE, MediaPlayerDef::OFF);
+bool HomeAssistant::resolveArtwork(EntityInterface *entity, const QString &url, QString *imageUrl) {
+    // the cached image is shown once it is downloaded, the previous one stays until then
+    m_awaitedArtwork.remove(entity->entity_id());
+    if (!m_artworkCache || url.isEmpty()) {
+        *imageUrl = url;
+        return true;
     }
-
-    QVariantMap haAttr = attr.value("attributes").toMap();
-    // source
-    if (entity->isSupported(MediaPlayerDef::F_SOURCE) && haAttr.contains("source")) {
-        entity->updateAttrByIndex(MediaPlayerDef::SOURCE, haAttr.value("source").toString());
+    *imageUrl = m_artworkCache->imageUrl(url);
+    if (imageUrl->isEmpty()) {
+        m_awaitedArtwork.insert(entity->entity_id(), ArtworkCache::keyOf(url));
+        return false;
     }
+    return true;
+}
 
-    // volume
-    if (entity->isSupported(MediaPlayerDef::F_VOLUME_SET) && haAttr.contains("volume_level")) {
-        entity->updateAttrByIndex(MediaPlayerDef::VOLUME,
-                                  static_cast<int>(round(haAttr.value("volume_level").toDouble() * 100)));
+void HomeAssistant::onArtworkReady(const QString &key, const QString &imageUrl) {
+    for (QHash<QString, QString>::iterator iter = m_awaitedArtwork.begin(); iter != m_awaitedArtwork.end();) {
+        if (iter.value() != key) {
+            ++iter;
+            continue;
+        }
+        QHash<QString, ManagedEntity>::iterator entity = m_managedEntities.find(iter.key());
+        if (entity == m_managedEntities.end()) {
+            iter = m_awaitedArtwork.erase(iter);
+            continue;
+        }
+        m_updater.pushAttribute(entity->entity, &entity->snapshot, MediaPlayerDef::MEDIAIMAGE,
+                                EntitySnapshot::MEDIA_IMAGE, &entity->snapshot.mediaImage, imageUrl);
+        iter = m_awaitedArtwork.erase(iter);
     }
+}
+
+QVariantMap HomeAssistant::commandStatistics() const {
+    QVariantMap statistics;
+    statistics.insert("slider_sent", m_sentSliderValues);
+    statistics.insert("slider_dropped", m_droppedSliderValues);
+    return statistics;
+}
 
-    // media type
-    if (entity->isSupported(MediaPlayerDef::F_MEDIA_TYPE) && haAttr.contains("media_content_type")) {
-        entity->updateAttrByIndex(MediaPlayerDef::MEDIATYPE, haAttr.value("media_content_type").toString());
+void HomeAssistant::recordStateLatency(const QString &entityId) {
+    QHash<QString, AwaitedStateChange>::iterator iter = m_awaitedStateChanges.find(entityId);
+    if (iter == m_awaitedStateChanges.end()) {
+        return;
+    }
+    // a command which does not change anything is never followed by a state change
+    if (!iter->sent.hasExpired(REQUEST_TIMEOUT)) {
+        m_stateLatency[iter->service].record(iter->sent.elapsed());
     }
+    m_awaitedStateChanges.erase(iter);
+}
 
-    // media image
-    if (entity->isSupported(MediaPlayerDef::F_MEDIA_IMAGE) && haAttr.contains("entity_picture")) {
-        QString url = haAttr.value("entity_picture").toString();
-        QString fullUrl = "";
-        if (url.contains("http")) {
-            fullUrl = url;
+void HomeAssistant::recordConnectStage(const QString &stage, qint64 elapsed) {
+    qCDebug(m_logCategory) << "Connection stage" << stage << "took" << elapsed << "ms";
+    m_connectLatency[stage].record(elapsed);
+}
+
+void HomeAssistant::onLogLatency() {
+    // drop the commands which were not followed by a state change
+    for (QHash<QString, AwaitedStateChange>::iterator iter = m_awaitedStateChanges.begin();
+         iter != m_awaitedStateChanges.end();) {
+        if (iter->sent.hasExpired(REQUEST_TIMEOUT)) {
+            iter = m_awaitedStateChanges.erase(iter);
         } else {
-            fullUrl = QString("http://").append(m_ip).append(url);
+            ++iter;
         }
-        entity->updateAttrByIndex(MediaPlayerDef::MEDIAIMAGE, fullUrl);
     }
 
-    // media title
-    if (entity->isSupported(MediaPlayerDef::F_MEDIA_TITLE) && haAttr.contains("media_title")) {
-        entity->updateAttrByIndex(MediaPlayerDef::MEDIATITLE, haAttr.value("media_title").toString());
+    for (QHash<QString, LatencyHistogram>::const_iterator iter = m_resultLatency.cbegin();
+         iter != m_resultLatency.cend(); ++iter) {
+        qCInfo(m_logCategory).noquote() << "Latency" << iter.key() << "result:" << iter->summary();
     }
-
-    // media artist
-    if (entity->isSupported(MediaPlayerDef::F_MEDIA_ARTIST) && haAttr.contains("media_artist")) {
-        entity->updateAttrByIndex(MediaPlayerDef::MEDIAARTIST, haAttr.value("media_artist").toString());
+    for (QHash<QString, LatencyHistogram>::const_iterator iter = m_stateLatency.cbegin();
+         iter != m_stateLatency.cend(); ++iter) {
+        qCInfo(m_logCategory).noquote() << "Latency" << iter.key() << "state change:" << iter->summary();
+    }
+    if (m_pingLatency.count() > 0) {
+        qCInfo(m_logCategory).noquote() << "Latency ping:" << m_pingLatency.summary();
+    }
+    for (QHash<QString, LatencyHistogram>::const_iterator iter = m_connectLatency.cbegin();
+         iter != m_connectLatency.cend(); ++iter) {
+        qCInfo(m_logCategory).noquote() << "Latency connect" << iter.key() << ":" << iter->summary();
+    }
+    if (Profiler::enabled()) {
+        qCInfo(m_logCategory).noquote() << "Profile:" << m_profiler.summary();
     }
 }
 
-void HomeAssistant::updateClimate(EntityInterface *entity, const QVariantMap &attr) {
-    // state
-    QString state = attr.value("state").toString();
-    if (state == "off") {
-        entity->setState(ClimateDef::OFF);
-    } else if (state == "heat") {
-        entity->setState(ClimateDef::HEAT);
-    } else if (state == "cool") {
-        entity->setState(ClimateDef::COOL);
+QVariantMap HomeAssistant::latencyStatistics() const {
+    QVariantMap result;
+    for (QHash<QString, LatencyHistogram>::const_iterator iter = m_resultLatency.cbegin();
+         iter != m_resultLatency.cend(); ++iter) {
+        result.insert(iter.key(), iter->toVariant());
     }
-
-    // current temperature
-    if (entity->isSupported(ClimateDef::F_TEMPERATURE) &&
-        attr.value("attributes").toMap().contains("current_temperature")) {
-        entity->updateAttrByIndex(ClimateDef::TEMPERATURE,
-                                  attr.value("attributes").toMap().value("current_temperature").toDouble());
+    QVariantMap stateChange;
+    for (QHash<QString, LatencyHistogram>::const_iterator iter = m_stateLatency.cbegin();
+         iter != m_stateLatency.cend(); ++iter) {
+        stateChange.insert(iter.key(), iter->toVariant());
     }
 
-    // target temperature
-    if (entity->isSupported(ClimateDef::F_TARGET_TEMPERATURE) &&
-        attr.value("attributes").toMap().contains("temperature")) {
-        entity->updateAttrByIndex(ClimateDef::TARGET_TEMPERATURE,
-                                  attr.value("attributes").toMap().value("temperature").toDouble());
-    }
+    QVariantMap statistics;
+    statistics.insert("result", result);
+    statistics.insert("state_change", stateChange);
+    statistics.insert("ping", m_pingLatency.toVariant());
+    statistics.insert("liveness_timeout", livenessTimeout());
 
-    // max and min temperatures
-    if (entity->isSupported(ClimateDef::F_TEMPERATURE_MAX) && attr.value("attributes").toMap().contains("max_temp")) {
-        entity->updateAttrByIndex(ClimateDef::TEMPERATURE_MAX,
-                                  attr.value("attributes").toMap().value("max_temp").toDouble());
+    QVariantMap connect;
+    for (QHash<QString, LatencyHistogram>::const_iterator iter = m_connectLatency.cbegin();
+         iter != m_connectLatency.cend(); ++iter) {
+        connect.insert(iter.key(), iter->toVariant());
     }
+    statistics.insert("connect", connect);
+    return statistics;
+}
+
+QVariantMap HomeAssistant::registrationStatistics() const {
+    QVariantMap statistics = m_lastRegistration;
+    statistics.insert("known", m_registrations.size());
+    return statistics;
+}
 
-    if (entity->isSupported(ClimateDef::F_TEMPERATURE_MIN) && attr.value("attributes").toMap().contains("min_temp")) {
-        entity->updateAttrByIndex(ClimateDef::TEMPERATURE_MIN,
-                                  attr.value("attributes").toMap().value("min_temp").toDouble());
+QVariantMap HomeAssistant::profileStatistics(bool reset) {
+    QVariantMap statistics;
+    statistics.insert("enabled", Profiler::enabled());
+    statistics.insert("scopes", m_profiler.statistics());
+    if (reset) {
+        m_profiler.reset();
     }
+    return statistics;
 }
 
-void HomeAssistant::updateSwitch(EntityInterface *entity, const QVariantMap &attr) {
-    // state
-    if (attr.value("state").toString() == "on") {
-        entity->setState(SwitchDef::ON);
-    } else {
-        entity->setState(SwitchDef::OFF);
+QVariantMap HomeAssistant::sendQueueStatistics() const {
+    QVariantMap statistics = m_sendQueue.statistics();
+    statistics.insert("bytes_in_flight", m_bytesInFlight);
+    return statistics;
+}
+
+QVariantMap HomeAssistant::updateStatistics() const {
+    QVariantMap statistics;
+    statistics.insert("pushed", m_updater.pushed());
+    statistics.insert("suppressed", m_updater.suppressed());
+    statistics.insert("outdated", m_outdatedUpdates);
+    statistics.insert("stale", m_staleEntities.size());
+    if (m_decodeWorker) {
+        statistics.insert("superseded", m_decodeWorker->superseded());
+        statistics.insert("decode_stalls", m_decodeWorker->stalls());
+        statistics.insert("decode_dropped", m_decodeWorker->dropped());
+        statistics.insert("decode_overflowed", m_decodeWorker->overflowed());
     }
+    return statistics;
 }
 
 void HomeAssistant::connect() {
@@ -475,16 +1332,86 @@ void HomeAssistant::connect() {
 
     setState(CONNECTING);
 
+    // show the last known states until the current ones are received
+    if (m_stateSnapshot && !m_stateSnapshotApplied) {
+        m_stateSnapshotApplied = true;
+        applyStateSnapshot();
+    }
+
     // reset the reconnnect trial variable
     m_tries = 0;
 
-    // turn on the websocket connection
+    // the previous connection is dropped without triggering a reconnect
     if (m_webSocket->isValid()) {
-        m_webSocket->close();
+        QObject::disconnect(m_webSocket, nullptr, this, nullptr);
+        m_webSocket->abort();
     }
 
-    qCDebug(m_logCategory) << "Connecting to HomeAssistant server:" << m_url;
-    m_webSocket->open(QUrl(m_url));
+    // turn on the websocket connection
+    m_connectTimer.start();
+    m_dialer->dial(m_endpoints);
+}
+
+void HomeAssistant::adoptSocket(QWebSocket *socket) {
+    if (m_webSocket) {
+        QObject::disconnect(m_webSocket, nullptr, this, nullptr);
+        m_webSocket->abort();
+        m_webSocket->deleteLater();
+    }
+    m_webSocket = socket;
+    m_webSocket->setParent(this);
+
+    QObject::connect(m_webSocket, &QWebSocket::textMessageReceived, this, &HomeAssistant::onTextMessageReceived);
+    QObject::connect(m_webSocket, static_cast<void (QWebSocket::*)(QAbstractSocket::SocketError)>(&QWebSocket::error),
+                     this, &HomeAssistant::onError);
+    QObject::connect(m_webSocket, &QWebSocket::stateChanged, this, &HomeAssistant::onStateChanged);
+    QObject::connect(m_webSocket, &QWebSocket::sslErrors, this,
+                     [this, socket](const QList<QSslError> &errors) { onSslError(socket, errors); });
+    QObject::connect(m_webSocket, &QWebSocket::bytesWritten, this, &HomeAssistant::onBytesWritten);
+}
+
+void HomeAssistant::onDialed(QWebSocket *socket, const QString &url) {
+    if (m_connectTimer.isValid()) {
+        recordConnectStage("dial", m_connectTimer.elapsed());
+    }
+    m_authTimer.start();
+    adoptSocket(socket);
+    m_url = url;
+    m_updater.setHttpUrl(EndpointDialer::httpUrl(url));
+    if (m_endpoints.value(0) != url) {
+        qCInfo(m_logCategory) << "Preferring endpoint" << url << "from now on";
+        m_endpoints.removeOne(url);
+        m_endpoints.prepend(url);
+        storePreferredEndpoint(url);
+    }
+    // Home Assistant starts the authentication on the new socket
+}
+
+void HomeAssistant::onDialFailed(const QString &errorString) {
+    qCWarning(m_logCategory) << "Cannot connect to any endpoint:" << errorString;
+    setState(DISCONNECTED);
+    m_wsReconnectTimer->start();
+}
+
+QString HomeAssistant::preferredEndpointFile() {
+    QString path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(path);
+    return path + "/homeassistant-" + integrationId() + ".endpoint";
+}
+
+QString HomeAssistant::loadPreferredEndpoint() {
+    QFile file(preferredEndpointFile());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll()).trimmed();
+}
+
+void HomeAssistant::storePreferredEndpoint(const QString &url) {
+    QSaveFile file(preferredEndpointFile());
+    if (!file.open(QIODevice::WriteOnly) || file.write(url.toUtf8()) < 0 || !file.commit()) {
+        qCWarning(m_logCategory) << "Cannot store the preferred endpoint" << file.errorString();
+    }
 }
 
 void HomeAssistant::disconnect() {
@@ -493,16 +1420,25 @@ void HomeAssistant::disconnect() {
 
     // turn of the reconnect try
     m_wsReconnectTimer->stop();
+    m_dialer->cancel();
 
     // turn off heartbeat
     m_heartbeatTimer->stop();
     m_heartbeatTimeoutTimer->stop();
+    resetRequests();
 
     // turn off the socket
     if (m_webSocket->isValid()) {
         m_webSocket->close();
     }
 
+    if (m_captureFile) {
+        m_captureFile->flush();
+    }
+    if (m_stateSnapshot && m_snapshotTimer->isActive()) {
+        writeStateSnapshot();
+    }
+
     setState(DISCONNECTED);
 }
 
@@ -510,241 +1446,308 @@ void HomeAssistant::enterStandby() {
     qCDebug(m_logCategory) << "Entering standby";
     m_heartbeatTimer->stop();
     m_heartbeatTimeoutTimer->stop();
+    if (m_stateSnapshot && m_snapshotTimer->isActive()) {
+        writeStateSnapshot();
+    }
+
+    // no events are received while the remote sleeps, a subscription still being requested is dropped once confirmed
+    m_standby = true;
+    if (m_subscriptionConfirmed) {
+        unsubscribeFromUpdates();
+    }
 }
 
 void HomeAssistant::leaveStandby() {
-    m_heartbeatTimer->start();
+    m_standby = false;
+    bool authenticated = m_webSocket->isValid() && m_authenticated;
+    if (authenticated) {
+        // the connection may have died while sleeping
+        sendPing();
+    }
+    if (!authenticated || m_subscriptionId != 0) {
+        m_heartbeatTimer->start(m_heartbeatCheckInterval);
+        return;
+    }
+
+    // resynchronise the configured entities, also after reconnecting in standby. The heartbeat is started again once
+    // subscribed.
+    qCDebug(m_logCategory) << "Leaving standby: resynchronising the entities";
+    if (m_subscribedEntities || m_statesPending) {
+        // the initial state of the compact subscription contains the current state of all configured entities, a
+        // state list still being fetched is reconciled with the events received meanwhile
+        subscribeToUpdates();
+    } else {
+        synchronise(true);
+    }
 }
 
 void HomeAssistant::sendCommand(const QString &type, const QString &entity_id, int command, const QVariant &param) {
-    if (type == "light") {
-        if (command == LightDef::C_TOGGLE) {
-            webSocketSendCommand(type, "toggle", entity_id, nullptr);
-        } else if (command == LightDef::C_ON) {
-            webSocketSendCommand(type, "turn_on", entity_id, nullptr);
-        } else if (command == LightDef::C_OFF) {
-            webSocketSendCommand(type, "turn_off", entity_id, nullptr);
-        } else if (command == LightDef::C_BRIGHTNESS) {
-            QVariantMap data;
-            data.insert("brightness_pct", param);
-            webSocketSendCommand(type, "turn_on", entity_id, &data);
-        } else if (command == LightDef::C_COLOR) {
-            QColor       color = param.value<QColor>();
-            QVariantMap  data;
-            QVariantList list;
-            list.append(color.red());
-            list.append(color.green());
-            list.append(color.blue());
-            data.insert("rgb_color", list);
-            webSocketSendCommand(type, "turn_on", entity_id, &data);
-        }
-    } else if (type == "blind") {
-        if (command == BlindDef::C_OPEN) {
-            webSocketSendCommand("cover", "open_cover", entity_id, nullptr);
-        } else if (command == BlindDef::C_CLOSE) {
-            webSocketSendCommand("cover", "close_cover", entity_id, nullptr);
-        } else if (command == BlindDef::C_STOP) {
-            webSocketSendCommand("cover", "stop_cover", entity_id, nullptr);
-        } else if (command == BlindDef::C_POSITION) {
-            QVariantMap data;
-            data.insert("position", param);
-            webSocketSendCommand("cover", "set_cover_position", entity_id, &data);
-        }
-    } else if (type == "media_player") {
-        if (command == MediaPlayerDef::C_VOLUME_SET) {
-            QVariantMap data;
-            data.insert("volume_level", param.toDouble() / 100);
-            webSocketSendCommand(type, "volume_set", entity_id, &data);
-        } else if (command == MediaPlayerDef::C_PLAY || command == MediaPlayerDef::C_PAUSE) {
-            webSocketSendCommand(type, "media_play_pause", entity_id, nullptr);
-        } else if (command == MediaPlayerDef::C_PREVIOUS) {
-            webSocketSendCommand(type, "media_previous_track", entity_id, nullptr);
-        } else if (command == MediaPlayerDef::C_NEXT) {
-            webSocketSendCommand(type, "media_next_track", entity_id, nullptr);
-        } else if (command == MediaPlayerDef::C_TURNON) {
-            webSocketSendCommand(type, "turn_on", entity_id, nullptr);
-        } else if (command == MediaPlayerDef::C_TURNOFF) {
-            webSocketSendCommand(type, "turn_off", entity_id, nullptr);
-        }
-    } else if (type == "climate") {
-        if (command == ClimateDef::C_ON) {
-            webSocketSendCommand(type, "turn_on", entity_id, nullptr);
-        } else if (command == ClimateDef::C_OFF) {
-            webSocketSendCommand(type, "turn_off", entity_id, nullptr);
-        } else if (command == ClimateDef::C_TARGET_TEMPERATURE) {
-            QVariantMap data;
-            data.insert("temperature", param.toDouble());
-            webSocketSendCommand(type, "set_temperature", entity_id, &data);
-        } else if (command == ClimateDef::C_HEAT) {
-            QVariantMap data;
-            data.insert("hvac_mode", "heat");
-            webSocketSendCommand(type, "set_hvac_mode", entity_id, &data);
-        } else if (command == ClimateDef::C_COOL) {
-            QVariantMap data;
-            data.insert("hvac_mode", "cool");
-            webSocketSendCommand(type, "set_hvac_mode", entity_id, &data);
+    HOMEASSISTANT_PROFILE_SCOPE(&m_profiler, QString("command.") + type);
+
+    QHash<QString, ManagedEntity>::iterator iter = m_managedEntities.find(entity_id);
+    if (iter == m_managedEntities.end()) {
+        // entity added after connecting
+        EntityInterface *entity = m_entities->getEntityInterface(entity_id);
+        if (!entity) {
+            qCWarning(m_logCategory) << "Cannot send command to unknown" << type << "entity" << entity_id;
+            return;
         }
-    } else if (type == "switch") {
-        QString haType = entity_id.split(".")[0];
-        if (command == SwitchDef::C_ON) {
-            webSocketSendCommand(haType, "turn_on", entity_id, nullptr);
-        } else if (command == SwitchDef::C_OFF) {
-            webSocketSendCommand(haType, "turn_off", entity_id, nullptr);
+        int managedEntityIds = m_managedEntityIds.size();
+        iter = addManagedEntity(entity);
+        if (m_managedEntityIds.size() != managedEntityIds) {
+            onManagedEntityAdded();
         }
-    } else if (type == "remote") {
-        EntityInterface *entity = m_entities->getEntityInterface(entity_id);
-        RemoteInterface *remoteInterface = static_cast<RemoteInterface *>(entity->getSpecificInterface());
-        QVariantList     commands = remoteInterface->commands();
-        QStringList      remoteCodes = findRemoteCodes(entity->getCommandName(command), commands);
-        QString          remoteDevice = findRemoteDevice(entity->getCommandName(command), commands);
+    }
 
-        if (remoteCodes.length() > 0) {
-            QVariantMap   data;
-            const QString ha_entity_id = entity_id.left(entity_id.indexOf('+'));
+    if (isSliderCommand(iter->type, command)) {
+        sendSliderCommand(*iter, command, param);
+    } else {
+        dispatchCommand(*iter, command, param, nullptr);
+    }
+}
 
-            if (remoteDevice.length() > 0) {
-                data.insert("device", remoteDevice);
-            }
+void HomeAssistant::dispatchCommand(const ManagedEntity &entity, int command, const QVariant &param,
+                                    const RequestTracker::Callback &callback) {
+    // indexed by EntityType
+    static const CommandHandler COMMAND_HANDLERS[] = {
+        &HomeAssistant::sendLightCommand,  &HomeAssistant::sendBlindCommand,  &HomeAssistant::sendMediaPlayerCommand,
+        &HomeAssistant::sendClimateCommand, &HomeAssistant::sendSwitchCommand, &HomeAssistant::sendRemoteCommand,
+        nullptr};
 
-            data.insert("command", remoteCodes);
-            webSocketSendCommand(type, "send_command", ha_entity_id, &data);
-        }
+    if (COMMAND_HANDLERS[entity.type]) {
+        (this->*COMMAND_HANDLERS[entity.type])(entity, command, param, callback);
+    }
+}
+
+bool HomeAssistant::isSliderCommand(EntityType type, int command) {
+    switch (type) {
+        case LIGHT:
+            return command == LightDef::C_BRIGHTNESS;
+        case BLIND:
+            return command == BlindDef::C_POSITION;
+        case MEDIA_PLAYER:
+            return command == MediaPlayerDef::C_VOLUME_SET;
+        case CLIMATE:
+            return command == ClimateDef::C_TARGET_TEMPERATURE;
+        default:
+            return false;
     }
 }
 
-QString HomeAssistant::findRemoteDevice(const QString &feature, const QVariantList &list) {
-    for (int i = 0; i < list.length(); i++) {
-        QVariantMap map = list[i].toMap();
-        if (map.value("button_map").toString() == feature) {
-            return map.value("device").toString();
+void HomeAssistant::sendSliderCommand(const ManagedEntity &entity, int command, const QVariant &param) {
+    SliderKey      key(entity.entity->entity_id(), command);
+    SliderCommand &slider = m_sliderCommands[key];
+
+    // latest value wins while the previous call is not acknowledged or the minimum interval has not passed yet
+    if (slider.inFlight || slider.scheduled) {
+        if (slider.pending) {
+            m_droppedSliderValues++;
         }
+        slider.pending = true;
+        slider.pendingParam = param;
+        return;
     }
 
-    return "";
+    qint64 wait = slider.lastSent.isValid() ? m_sliderInterval - slider.lastSent.elapsed() : 0;
+    if (wait > 0) {
+        slider.pending = true;
+        slider.pendingParam = param;
+        slider.scheduled = true;
+        QTimer::singleShot(static_cast<int>(wait), this, [this, key]() { flushSliderCommand(key); });
+        return;
+    }
+
+    slider.pending = false;
+    slider.inFlight = true;
+    slider.lastSent.start();
+    // the next value is sent once the call_service result arrived or the request timed out, expired or was dropped.
+    // The command handlers send every command isSliderCommand accepts.
+    m_sentSliderValues++;
+    dispatchCommand(entity, command, param,
+                    [this, key](const RequestTracker::Result &) { onSliderCommandResult(key); });
 }
 
-QStringList HomeAssistant::findRemoteCodes(const QString &feature, const QVariantList &list) {
-    QStringList r;
+void HomeAssistant::flushSliderCommand(const SliderKey &key) {
+    QHash<SliderKey, SliderCommand>::iterator slider = m_sliderCommands.find(key);
+    if (slider == m_sliderCommands.end()) {
+        return;
+    }
+    slider->scheduled = false;
+    if (!slider->pending || slider->inFlight) {
+        return;
+    }
 
-    for (int i = 0; i < list.length(); i++) {
-        QVariantMap map = list[i].toMap();
-        if (map.value("button_map").toString() == feature) {
-            r += map.value("code").toString().split(',');
-        }
+    QHash<QString, ManagedEntity>::iterator entity = m_managedEntities.find(key.first);
+    if (entity == m_managedEntities.end()) {
+        m_sliderCommands.erase(slider);
+        return;
     }
+    QVariant param = slider->pendingParam;
+    slider->pending = false;
+    sendSliderCommand(*entity, key.second, param);
+}
 
-    return r;
+void HomeAssistant::onSliderCommandResult(const SliderKey &key) {
+    QHash<SliderKey, SliderCommand>::iterator slider = m_sliderCommands.find(key);
+    if (slider != m_sliderCommands.end()) {
+        slider->inFlight = false;
+        flushSliderCommand(key);
+    }
 }
 
-void HomeAssistant::onHeartbeat() {
-    qCDebug(m_logCategory) << "Sending hearbeat request";
-    m_webSocketId++;
-    QString msg = QString("{ \"id\": \"%1\", \"type\": \"ping\" }\n").arg(m_webSocketId);
-    if (m_webSocket->isValid()) {
-        m_webSocket->sendTextMessage(msg);
+void HomeAssistant::sendLightCommand(const ManagedEntity &entity, int command, const QVariant &param,
+                                     const RequestTracker::Callback &callback) {
+    if (command == LightDef::C_TOGGLE) {
+        webSocketSendCommand(entity, SERVICE_TOGGLE, callback);
+    } else if (command == LightDef::C_ON) {
+        webSocketSendCommand(entity, SERVICE_TURN_ON, callback);
+    } else if (command == LightDef::C_OFF) {
+        webSocketSendCommand(entity, SERVICE_TURN_OFF, callback);
+    } else if (command == LightDef::C_BRIGHTNESS) {
+        beginCommand(entity, SERVICE_TURN_ON)->add("brightness_pct", param.toInt());
+        sendCommandMessage(callback);
+    } else if (command == LightDef::C_COLOR) {
+        QColor color = param.value<QColor>();
+        int    rgb[] = {color.red(), color.green(), color.blue()};
+        beginCommand(entity, SERVICE_TURN_ON)->add("rgb_color", rgb, 3);
+        sendCommandMessage(callback);
     }
-    m_heartbeatTimeoutTimer->start();
 }
 
-void HomeAssistant::onHeartbeatTimeout() {
-    disconnect();
+void HomeAssistant::sendBlindCommand(const ManagedEntity &entity, int command, const QVariant &param,
+                                     const RequestTracker::Callback &callback) {
+    if (command == BlindDef::C_OPEN) {
+        webSocketSendCommand(entity, SERVICE_OPEN_COVER, callback);
+    } else if (command == BlindDef::C_CLOSE) {
+        webSocketSendCommand(entity, SERVICE_CLOSE_COVER, callback);
+    } else if (command == BlindDef::C_STOP) {
+        webSocketSendCommand(entity, SERVICE_STOP_COVER, callback);
+    } else if (command == BlindDef::C_POSITION) {
+        beginCommand(entity, SERVICE_SET_COVER_POSITION)->add("position", param.toInt());
+        sendCommandMessage(callback);
+    }
+}
 
-    QObject *param = this;
-    m_notifications->add(
-        true, tr("Connection lost to ").append(friendlyName()).append("."), tr("Reconnect"),
-        [](QObject *param) {
-            Integration *i = qobject_cast<Integration *>(param);
-            i->connect();
-        },
-        param);
+void HomeAssistant::sendMediaPlayerCommand(const ManagedEntity &entity, int command, const QVariant &param,
+                                           const RequestTracker::Callback &callback) {
+    if (command == MediaPlayerDef::C_VOLUME_SET) {
+        beginCommand(entity, SERVICE_VOLUME_SET)->add("volume_level", param.toDouble() / 100);
+        sendCommandMessage(callback);
+    } else if (command == MediaPlayerDef::C_PLAY || command == MediaPlayerDef::C_PAUSE) {
+        webSocketSendCommand(entity, SERVICE_MEDIA_PLAY_PAUSE, callback);
+    } else if (command == MediaPlayerDef::C_PREVIOUS) {
+        webSocketSendCommand(entity, SERVICE_MEDIA_PREVIOUS_TRACK, callback);
+    } else if (command == MediaPlayerDef::C_NEXT) {
+        webSocketSendCommand(entity, SERVICE_MEDIA_NEXT_TRACK, callback);
+    } else if (command == MediaPlayerDef::C_TURNON) {
+        webSocketSendCommand(entity, SERVICE_TURN_ON, callback);
+    } else if (command == MediaPlayerDef::C_TURNOFF) {
+        webSocketSendCommand(entity, SERVICE_TURN_OFF, callback);
+    }
 }
 
-QStringList HomeAssistant::supportedFeatures(const QString &entityType, const int &supportedFeatures) {
-    QStringList features;
+void HomeAssistant::sendClimateCommand(const ManagedEntity &entity, int command, const QVariant &param,
+                                       const RequestTracker::Callback &callback) {
+    if (command == ClimateDef::C_ON) {
+        webSocketSendCommand(entity, SERVICE_TURN_ON, callback);
+    } else if (command == ClimateDef::C_OFF) {
+        webSocketSendCommand(entity, SERVICE_TURN_OFF, callback);
+    } else if (command == ClimateDef::C_TARGET_TEMPERATURE) {
+        beginCommand(entity, SERVICE_SET_TEMPERATURE)->add("temperature", param.toDouble());
+        sendCommandMessage(callback);
+    } else if (command == ClimateDef::C_HEAT) {
+        beginCommand(entity, SERVICE_SET_HVAC_MODE)->add("hvac_mode", QStringLiteral("heat"));
+        sendCommandMessage(callback);
+    } else if (command == ClimateDef::C_COOL) {
+        beginCommand(entity, SERVICE_SET_HVAC_MODE)->add("hvac_mode", QStringLiteral("cool"));
+        sendCommandMessage(callback);
+    }
+}
 
-    if (entityType == "light") {
-        if (supportedFeatures & LightFeatures::SUPPORT_BRIGHTNESS) {
-            features.append("BRIGHTNESS");
-        }
-        if (supportedFeatures & LightFeatures::SUPPORT_COLOR) {
-            features.append("COLOR");
-        }
-        if (supportedFeatures & LightFeatures::SUPPORT_COLOR_TEMP) {
-            features.append("COLORTEMP");
-        }
-    } else if (entityType == "blind") {
-        if (supportedFeatures & BlindFeatures::SUPPORT_OPEN) {
-            features.append("OPEN");
-        }
-        if (supportedFeatures & BlindFeatures::SUPPORT_CLOSE) {
-            features.append("CLOSE");
-        }
-        if (supportedFeatures & BlindFeatures::SUPPORT_STOP) {
-            features.append("STOP");
-        }
-        if (supportedFeatures & BlindFeatures::SUPPORT_SET_POSITION) {
-            features.append("POSITION");
-        }
-    } else if (entityType == "climate") {
-        features.append("TEMPERATURE");
-        if (supportedFeatures & ClimateFeatures::SUPPORT_TARGET_TEMPERATURE) {
-            features.append("TARGET_TEMPERATURE");
-        }
-        if (supportedFeatures & ClimateFeatures::SUPPORT_TARGET_TEMPERATURE_RANGE) {
-            features.append("TEMPERATURE_MIN");
-            features.append("TEMPERATURE_MAX");
-        }
-    } else if (entityType == "media_player") {
-        features.append("APP_NAME");
-        features.append("MEDIA_ALBUM");
-        features.append("MEDIA_ARTIST");
-        features.append("MEDIA_IMAGE");
-        features.append("MEDIA_TITLE");
-        features.append("MEDIA_TYPE");
+void HomeAssistant::sendSwitchCommand(const ManagedEntity &entity, int command, const QVariant &param,
+                                      const RequestTracker::Callback &callback) {
+    Q_UNUSED(param)
+    // the domain is either switch or input_boolean
+    if (command == SwitchDef::C_ON) {
+        webSocketSendCommand(entity, SERVICE_TURN_ON, callback);
+    } else if (command == SwitchDef::C_OFF) {
+        webSocketSendCommand(entity, SERVICE_TURN_OFF, callback);
+    }
+}
 
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_PAUSE) {
-            features.append("PAUSE");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_SEEK) {
-            features.append("SEEK");
-            features.append("MEDIA_DURATION");
-            features.append("MEDIA_POSITION");
-            features.append("MEDIA_PROGRESS");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_VOLUME_SET) {
-            features.append("VOLUME_SET");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_VOLUME_MUTE) {
-            features.append("MUTE");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_PREVIOUS_TRACK) {
-            features.append("PREVIOUS");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_NEXT_TRACK) {
-            features.append("NEXT");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_TURN_ON) {
-            features.append("TURN_ON");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_TURN_OFF) {
-            features.append("TURN_OFF");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_VOLUME_STEP) {
-            features.append("VOLUME_DOWN");
-            features.append("VOLUME_UP");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_SELECT_SOURCE) {
-            features.append("SOURCE");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_STOP) {
-            features.append("STOP");
-        }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_PLAY) {
-            features.append("PLAY");
+void HomeAssistant::sendRemoteCommand(const ManagedEntity &entity, int command, const QVariant &param,
+                                      const RequestTracker::Callback &callback) {
+    Q_UNUSED(param)
+    const RemoteCode *remoteCode = findRemoteCode(entity, entity.entity->getCommandName(command));
+
+    if (remoteCode && remoteCode->codes.length() > 0) {
+        CommandSerializer *call = beginCommand(entity, SERVICE_SEND_COMMAND);
+
+        if (remoteCode->device.length() > 0) {
+            call->add("device", remoteCode->device);
         }
-        if (supportedFeatures & MediaPlayerFeatures::SUPPORT_SHUFFLE_SET) {
-            features.append("SHUFFLE");
+
+        call->add("command", remoteCode->codes);
+        sendCommandMessage(callback);
+    }
+}
+
+const RemoteCode *HomeAssistant::findRemoteCode(const ManagedEntity &entity, const QString &feature) {
+    RemoteInterface *remoteInterface = static_cast<RemoteInterface *>(entity.entity->getSpecificInterface());
+    return m_remoteIndex[entity.entity->entity_id()].find(remoteInterface->commands(), feature);
+}
+
+void HomeAssistant::onHeartbeat() {
+    // a ping is only needed if nothing was received for the idle interval
+    qint64 idle = m_lastReceived.isValid() ? m_lastReceived.elapsed() : m_heartbeatCheckInterval;
+    if (idle < m_heartbeatCheckInterval) {
+        m_heartbeatTimer->start(static_cast<int>(m_heartbeatCheckInterval - idle));
+        return;
+    }
+    sendPing();
+    m_heartbeatTimer->start(m_heartbeatCheckInterval);
+}
+
+void HomeAssistant::sendPing() {
+    if (!m_webSocket->isValid() || m_heartbeatTimeoutTimer->isActive()) {
+        return;
+    }
+    qCDebug(m_logCategory) << "Sending hearbeat request";
+    int         timeout = livenessTimeout();
+    QVariantMap map;
+    map.insert("type", QVariant("ping"));
+    // a missing pong is handled by the heartbeat timeout timer, any other received message stops it as well
+    sendRequest(RequestTracker::PING, &map, timeout, [this](const RequestTracker::Result &result) {
+        if (result.success) {
+            qCDebug(m_logCategory) << "Got heartbeat!";
+            m_pingLatency.record(result.elapsed);
+            updateRoundTripTime(result.elapsed);
         }
+    });
+    m_heartbeatTimeoutTimer->start(timeout);
+}
+
+void HomeAssistant::updateRoundTripTime(qint64 rtt) {
+    // smoothed round trip time and its variation as used for TCP retransmission timeouts (RFC 6298)
+    if (m_smoothedRtt == 0) {
+        m_smoothedRtt = rtt;
+        m_rttVariation = rtt / 2.0;
+    } else {
+        m_rttVariation = 0.75 * m_rttVariation + 0.25 * qAbs(m_smoothedRtt - rtt);
+        m_smoothedRtt = 0.875 * m_smoothedRtt + 0.125 * rtt;
     }
-    return features;
+}
+
+int HomeAssistant::livenessTimeout() const {
+    if (m_smoothedRtt == 0) {
+        return LIVENESS_TIMEOUT_INITIAL;
+    }
+    return qBound(LIVENESS_TIMEOUT_MIN, static_cast<int>(m_smoothedRtt + 4 * m_rttVariation), LIVENESS_TIMEOUT_MAX);
+}
+
+void HomeAssistant::onHeartbeatTimeout() {
+    // reconnect right away, the user is only notified if the reconnection attempts fail
+    qCWarning(m_logCategory) << "Connection lost: nothing received for" << m_lastReceived.elapsed()
+                             << "ms, reconnecting";
+    m_webSocket->abort();
 }
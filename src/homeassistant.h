@@ -24,14 +24,30 @@
 #pragma once
 
 #include <QColor>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
 #include <QLoggingCategory>
 #include <QObject>
+#include <QPair>
+#include <QSet>
 #include <QString>
 #include <QThread>
 #include <QTimer>
 #include <QVariant>
 #include <QtWebSockets/QWebSocket>
 
+#include "homeassistant_artwork.h"
+#include "homeassistant_decoder.h"
+#include "homeassistant_decodeworker.h"
+#include "homeassistant_dialer.h"
+#include "homeassistant_entityupdater.h"
+#include "homeassistant_latency.h"
+#include "homeassistant_profiler.h"
+#include "homeassistant_remoteindex.h"
+#include "homeassistant_requests.h"
+#include "homeassistant_sendqueue.h"
+#include "homeassistant_serializer.h"
 #include "homeassistant_supportedfeatures.h"
 #include "yio-interface/configinterface.h"
 #include "yio-interface/entities/entitiesinterface.h"
@@ -76,6 +92,44 @@ class HomeAssistant : public Integration {
 
     void sendCommand(const QString& type, const QString& entityId, int command, const QVariant& param) override;
 
+    /**
+     * @brief Returns the number of entity attribute updates pushed to the entities, suppressed as unchanged and skipped
+     * as older than the applied state, the number of entities still showing their state of the snapshot and, with the
+     * decode thread, the number of updates superseded before being applied, how often the decoder waited for its
+     * records to be taken, the number of frames held back and of events dropped with a full decode queue
+     */
+    Q_INVOKABLE QVariantMap updateStatistics() const;
+
+    /**
+     * @brief Returns the number of sent slider commands and of intermediate slider values dropped by coalescing
+     */
+    Q_INVOKABLE QVariantMap commandStatistics() const;
+
+    /**
+     * @brief Returns the latency histograms of the commands per domain.service until the result and until the first
+     * state change of the entity, of the heartbeat ping with the current liveness timeout and of the connection stages
+     */
+    Q_INVOKABLE QVariantMap latencyStatistics() const;
+
+    /**
+     * @brief Returns the number of available entities registered as new or changed, unchanged and known by their
+     * signature, and the entity ids removed from Home Assistant, of the last synchronisation
+     */
+    Q_INVOKABLE QVariantMap registrationStatistics() const;
+
+    /**
+     * @brief Returns the call counts, wall and CPU time in µs and heap growth in bytes per received message type,
+     * update handler domain, command entity type and sent command domain. Only collected in a build with
+     * CONFIG+=profiling.
+     */
+    Q_INVOKABLE QVariantMap profileStatistics(bool reset = false);
+
+    /**
+     * @brief Returns the current depth and the wait time histogram of the send queue per priority, the expired and
+     * dropped messages and the bytes not yet written by the socket
+     */
+    Q_INVOKABLE QVariantMap sendQueueStatistics() const;
+
  public slots:
     void connect() override;
     void disconnect() override;
@@ -86,30 +140,225 @@ class HomeAssistant : public Integration {
     void onStateChanged(QAbstractSocket::SocketState state);
     void onError(QAbstractSocket::SocketError error);
     void onTimeout();
-    void onSslError(QList<QSslError>);
+    void onSslError(QWebSocket* socket, const QList<QSslError>& errors);
 
  private:
-    void webSocketSendCommand(const QString& domain, const QString& service, const QString& entity_id,
-                              QVariantMap* data);
-    int  convertBrightnessToPercentage(float value);
+    /**
+     * @brief Queues a request, it is sent with the next message id and tracked until its result arrives or it times out
+     */
+    void sendRequest(RequestTracker::Kind kind, QVariantMap* message, int timeout,
+                     const RequestTracker::Callback& callback, const QString& entityId = QString());
+
+    /**
+     * @brief Messages are queued by priority while the socket has not written the previous ones. Expired and dropped
+     * messages are completed with an error.
+     */
+    void enqueueMessage(const SendQueue::Message& message);
+    void flushSendQueue();
+    void sendMessage(QString* body, RequestTracker::Kind kind, const QString& entityId, const QString& service,
+                     int timeout, const RequestTracker::Callback& callback);
+    void failMessage(const SendQueue::Message& message, const QString& errorMessage);
+
+    /**
+     * @brief Sends a text message and counts its bytes on the wire, the unit of the bytesWritten signal
+     */
+    void writeMessage(const QString& message);
+    void onBytesWritten(qint64 bytes);
+
+    /**
+     * @brief Drops the pending and queued requests of the connection, their callbacks are completed as dropped
+     */
+    void resetRequests();
+
+    /**
+     * @brief The socket of the endpoint which connected first replaces the current one. The winner is stored and
+     * dialed first the next time.
+     */
+    void    adoptSocket(QWebSocket* socket);
+    void    onDialed(QWebSocket* socket, const QString& url);
+    void    onDialFailed(const QString& errorString);
+    QString preferredEndpointFile();
+    QString loadPreferredEndpoint();
+    void    storePreferredEndpoint(const QString& url);
+
+    /**
+     * @brief Appends a received frame to the capture file, which is rotated once it reaches capture_max_size
+     */
+    void captureFrame(const QString& message);
+
+    void onDecodedRecords();
+    /**
+     * @brief Resynchronises the entities after the decoder dropped state change events
+     */
+    void onDecodeEventsLost();
+    void processMessage(const QByteArray& frame, const HomeAssistantMessage& message);
+    void processEvent(const QByteArray& frame, const HomeAssistantMessage& message, bool compressed);
+    void applyStateChange(const EntityStateChange& change);
+    /**
+     * @brief Subscribes to state updates and requests the state list in parallel. State changes received until the
+     * states are applied are held back and reconciled by their last_updated time. On resync only the configured
+     * entities are updated and nothing is registered.
+     */
+    void synchronise(bool resync);
+    void onStatesReceived(const RequestTracker::Result& result);
+    void processStatesSlice(int generation);
+    void applyEarlyChanges();
+    void reportRemovedEntities(int generation);
+    void registerAvailableEntities(int generation);
+    void onSubscribed(const RequestTracker::Result& result);
+    void completeConnection();
+    void recordConnectStage(const QString& stage, qint64 elapsed);
+    void onCommandResult(const RequestTracker::Result& result);
+    void recordStateLatency(const QString& entityId);
+    void onLogLatency();
+
+    /**
+     * @brief The last known states of the managed entities are applied when connecting for the first time and stored
+     * after changes, before standby and when disconnecting
+     */
+    QString stateSnapshotFile();
+    void    applyStateSnapshot();
+    void    writeStateSnapshot();
+
+    /**
+     * @brief Shows the entities still holding their snapshot state once connected as unavailable, like Home Assistant
+     * reports an entity it cannot reach. The next live update pushes their complete state.
+     */
+    void markStaleEntities();
+
+    enum EntityType { LIGHT, BLIND, MEDIA_PLAYER, CLIMATE, SWITCH, REMOTE, UNSUPPORTED };
+
+    /**
+     * @brief An entity of this integration, resolved once when the entities are loaded
+     */
+    struct ManagedEntity {
+        EntityInterface* entity = nullptr;
+        EntityType       type = UNSUPPORTED;
+        QString          haDomain;
+        QString          haEntityId;
+        EntitySnapshot   snapshot;
+        EntityState      lastState;
+    };
 
-    void updateEntity(const QString& entity_id, const QVariantMap& attr);
-    void updateLight(EntityInterface* entity, const QVariantMap& attr);
-    void updateBlind(EntityInterface* entity, const QVariantMap& attr);
-    void updateMediaPlayer(EntityInterface* entity, const QVariantMap& attr);
-    void updateClimate(EntityInterface* entity, const QVariantMap& attr);
-    void updateSwitch(EntityInterface* entity, const QVariantMap& attr);
+    /**
+     * @brief Latest-wins state of a slider command (brightness, volume, position, temperature) of an entity
+     */
+    struct SliderCommand {
+        bool          inFlight = false;
+        bool          scheduled = false;
+        bool          pending = false;
+        QVariant      pendingParam;
+        QElapsedTimer lastSent;
+    };
+    // entity id and command
+    typedef QPair<QString, int> SliderKey;
 
+    /**
+     * @brief An entity of the get_states result, added to the available entities after the configured entities were
+     * updated
+     */
+    struct AvailableEntity {
+        QString entityId;
+        QString type;
+        QString friendlyName;
+        int     supportedFeatures = 0;
+        uint    signature = 0;
+    };
+
+    /**
+     * @brief Signature of the domain, friendly name and supported features of a registered available entity and the
+     * generation of the state list it was last seen in
+     */
+    struct Registration {
+        uint signature = 0;
+        bool registered = false;
+        int  generation = 0;
+    };
+
+    typedef void (EntityUpdater<EntityInterface>::*UpdateHandler)(EntityInterface*, const EntityState&,
+                                                                 EntitySnapshot*);
+    typedef void (HomeAssistant::*CommandHandler)(const ManagedEntity&, int, const QVariant&,
+                                                  const RequestTracker::Callback&);
+
+    static EntityType    entityTypeOf(const QString& type);
+    static UpdateHandler updateHandlerOf(EntityType type);
+
+    /**
+     * @brief Resolves an entity of this integration and adds its Home Assistant entity id to the managed ones
+     */
+    QHash<QString, ManagedEntity>::iterator addManagedEntity(EntityInterface* entity);
+
+    void updateEntity(const EntityState& attr);
+    /**
+     * @brief Returns false while the cached artwork of the URL is downloaded, onArtworkReady pushes it then
+     */
+    bool resolveArtwork(EntityInterface* entity, const QString& url, QString* imageUrl);
+    void onArtworkReady(const QString& key, const QString& imageUrl);
+
+    /**
+     * @brief Pings after the idle interval without received messages. The connection is considered lost if nothing is
+     * received within the liveness timeout derived from the measured round trip time.
+     */
     void onHeartbeat();
     void onHeartbeatTimeout();
+    void sendPing();
+    void updateRoundTripTime(qint64 rtt);
+    int  livenessTimeout() const;
 
-    QStringList findRemoteCodes(const QString& feature, const QVariantList& list);
-    QString     findRemoteDevice(const QString& feature, const QVariantList& list);
+    /**
+     * @brief Subscribes to state updates: compact entity diffs if supported by the server, state_changed events
+     * otherwise
+     */
+    void        subscribeToUpdates();
+    void        unsubscribeFromUpdates();
+    void        rebuildManagedEntities();
+    void        onManagedEntityAdded();
+
+    /**
+     * @brief Returns true for a state_changed event frame of an entity not used by the remote. Checked on the raw frame
+     * before anything is decoded.
+     */
+    bool        isUnmanagedEvent(const QString& message) const;
 
     /**
-     * @brief Returns a list of supported features converted from the Home Assistant format
+     * @brief Returns true if the given Home Assistant version supports the subscribe_entities command
      */
-    QStringList supportedFeatures(const QString& entityType, const int& supportedFeatures);
+    static bool supportsSubscribeEntities(const QString& haVersion);
+
+    /**
+     * @brief Sends the command with its handler, the callback is called with the call_service result in addition to
+     * the latency recording
+     */
+    void        dispatchCommand(const ManagedEntity& entity, int command, const QVariant& param,
+                                const RequestTracker::Callback& callback);
+    static bool isSliderCommand(EntityType type, int command);
+    void        sendSliderCommand(const ManagedEntity& entity, int command, const QVariant& param);
+    void        flushSliderCommand(const SliderKey& key);
+    void        onSliderCommandResult(const SliderKey& key);
+
+    void sendLightCommand(const ManagedEntity& entity, int command, const QVariant& param,
+                          const RequestTracker::Callback& callback);
+    void sendBlindCommand(const ManagedEntity& entity, int command, const QVariant& param,
+                          const RequestTracker::Callback& callback);
+    void sendMediaPlayerCommand(const ManagedEntity& entity, int command, const QVariant& param,
+                                const RequestTracker::Callback& callback);
+    void sendClimateCommand(const ManagedEntity& entity, int command, const QVariant& param,
+                            const RequestTracker::Callback& callback);
+    void sendSwitchCommand(const ManagedEntity& entity, int command, const QVariant& param,
+                           const RequestTracker::Callback& callback);
+    void sendRemoteCommand(const ManagedEntity& entity, int command, const QVariant& param,
+                           const RequestTracker::Callback& callback);
+
+    /**
+     * @brief Starts a call_service message of the entity, the service data is added to the returned serializer before
+     * sending it with sendCommandMessage
+     */
+    CommandSerializer* beginCommand(const ManagedEntity& entity, const QString& service);
+    void               sendCommandMessage(const RequestTracker::Callback& next);
+    void               webSocketSendCommand(const ManagedEntity& entity, const QString& service,
+                                            const RequestTracker::Callback& callback);
+
+    const RemoteCode* findRemoteCode(const ManagedEntity& entity, const QString& feature);
 
  private:
     QString     m_ip;
@@ -117,12 +366,108 @@ class HomeAssistant : public Integration {
     bool        m_ssl;
     bool        m_ignoreSsl;
     QString     m_url;
-    QWebSocket* m_webSocket;
+    bool        m_compactUpdates = true;
+    QWebSocket* m_webSocket = nullptr;
     QTimer*     m_wsReconnectTimer;
     int         m_tries;
-    int         m_webSocketId;
     bool        m_userDisconnect = false;
     int         m_heartbeatCheckInterval = 30000;
     QTimer*     m_heartbeatTimer = new QTimer(this);
     QTimer*     m_heartbeatTimeoutTimer = new QTimer(this);
+
+    // websocket URLs of the server in order of preference, the last winner first
+    QStringList     m_endpoints;
+    EndpointDialer* m_dialer;
+
+    // time since the last received frame and the smoothed ping round trip time in ms
+    QElapsedTimer m_lastReceived;
+    double        m_smoothedRtt = 0;
+    double        m_rttVariation = 0;
+
+    // pending requests by message id and requests waiting to be sent
+    RequestTracker*          m_requests;
+    SendQueue                m_sendQueue;
+    qint64                   m_bytesInFlight = 0;
+    CommandSerializer        m_serializer;
+
+    QString m_haVersion;
+    int     m_subscriptionId = 0;
+    bool    m_subscriptionConfirmed = false;
+    bool    m_subscribedEntities = false;
+    bool    m_authenticated = false;
+    bool    m_standby = false;
+    // last known state of each entity subscribed with subscribe_entities, required to apply the compact diffs
+    QHash<QString, EntityState> m_entityStates;
+    // entities of this integration by entity id
+    QHash<QString, ManagedEntity> m_managedEntities;
+    // Home Assistant entity ids used by the remote and the subscription event frame prefix for the pre-decode filter
+    QSet<QString> m_managedEntityIds;
+    QString       m_eventFramePrefix;
+
+    // get_states result processed in slices: payload, reader position of the next entity and entities to register
+    QByteArray                   m_statesFrame;
+    int                          m_statesPosition = 0;
+    int                          m_statesGeneration = 0;
+    bool                         m_statesResync = false;
+    bool                         m_statesPending = false;
+    QVector<EntityStateChange>   m_earlyChanges;
+    QElapsedTimer                m_statesTimer;
+    QVector<AvailableEntity>     m_availableEntities;
+    int                          m_registeredEntities = 0;
+    int                          m_statesCount = 0;
+    int                          m_unchangedEntities = 0;
+    QHash<QString, Registration> m_registrations;
+    QVariantMap                  m_lastRegistration;
+
+    EntityUpdater<EntityInterface> m_updater;
+    quint64                        m_outdatedUpdates = 0;
+
+    bool    m_stateSnapshot = true;
+    bool    m_stateSnapshotApplied = false;
+    QTimer* m_snapshotTimer;
+    // entities showing a state of the snapshot which was not yet confirmed by Home Assistant and the notification
+    // telling the user how many of them Home Assistant does not know
+    QSet<QString> m_staleEntities;
+    QString       m_staleNotification;
+
+    // slider commands: only the latest value is sent once the previous call is acknowledged
+    int                             m_sliderInterval = 100;
+    QHash<SliderKey, SliderCommand> m_sliderCommands;
+    quint64                         m_sentSliderValues = 0;
+    quint64                         m_droppedSliderValues = 0;
+
+    /**
+     * @brief A sent command waiting for the first state change of its entity
+     */
+    struct AwaitedStateChange {
+        QString       service;
+        QElapsedTimer sent;
+    };
+
+    // command latencies by domain.service
+    QHash<QString, LatencyHistogram>   m_resultLatency;
+    QHash<QString, LatencyHistogram>   m_stateLatency;
+    LatencyHistogram                   m_pingLatency;
+    // duration of the connection stages, from dialing the endpoints until connected
+    QHash<QString, LatencyHistogram>   m_connectLatency;
+    QElapsedTimer                      m_connectTimer;
+    QElapsedTimer                      m_authTimer;
+    QHash<QString, AwaitedStateChange> m_awaitedStateChanges;
+    QTimer*                            m_latencyLogTimer;
+
+    // button codes of the remote entities by entity id
+    QHash<QString, RemoteIndex> m_remoteIndex;
+
+    Profiler m_profiler;
+
+    FeatureMapper m_featureMapper;
+
+    DecodeWorker* m_decodeWorker = nullptr;
+    ArtworkCache* m_artworkCache = nullptr;
+    // artwork cache key each media player waits for until the cached image is ready
+    QHash<QString, QString> m_awaitedArtwork;
+
+    // received frames are appended to this file if capture_file is configured
+    QFile* m_captureFile = nullptr;
+    qint64 m_captureMaxSize = 0;
 };
@@ -0,0 +1,213 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_artwork.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QtConcurrent>
+
+namespace {
+// retry time in ms after the first failed download, doubled with every further failure
+const int RETRY_BACKOFF_INITIAL = 30000;
+const int RETRY_BACKOFF_MAX = 3600000;
+// failures remembered before the expired ones are forgotten
+const int MAX_FAILURES = 256;
+// a download is aborted if no data arrived for this time in ms
+const int TRANSFER_TIMEOUT = 15000;
+// property of a download reply holding the requested URL, the URL of the request may be normalized
+const char *const URL_PROPERTY = "artworkUrl";
+}  // namespace
+
+ArtworkCache::ArtworkCache(const QString &directory, int imageSize, qint64 maxSize, bool ignoreSsl,
+                           const QLoggingCategory &logCategory, QObject *parent)
+    : QObject(parent),
+      m_directory(directory),
+      m_imageSize(imageSize),
+      m_maxSize(maxSize),
+      m_ignoreSsl(ignoreSsl),
+      m_logCategory(logCategory) {
+    m_network = new QNetworkAccessManager(this);
+    QObject::connect(m_network, &QNetworkAccessManager::finished, this, &ArtworkCache::onFinished);
+
+    QDir().mkpath(m_directory);
+    loadIndex();
+}
+
+QString ArtworkCache::imageUrl(const QString &url) {
+    QString                         key = keyOf(url);
+    QHash<QString, Entry>::iterator iter = m_entries.find(key);
+    if (iter != m_entries.end()) {
+        if (QFileInfo::exists(iter->fileName)) {
+            iter->lastUsed = ++m_useCounter;
+            return QUrl::fromLocalFile(iter->fileName).toString();
+        }
+        m_size -= iter->size;
+        m_entries.erase(iter);
+    }
+
+    // a failed image is shown from its original URL until it is retried
+    QHash<QString, Failure>::const_iterator failure = m_failures.constFind(key);
+    if (failure != m_failures.cend() && !failure->failed.hasExpired(failure->backoff)) {
+        return url;
+    }
+
+    if (!m_pending.contains(key)) {
+        QNetworkReply *reply = m_network->get(QNetworkRequest(QUrl(url)));
+        reply->setProperty(URL_PROPERTY, url);
+        if (m_ignoreSsl) {
+            reply->ignoreSslErrors();
+        }
+        // a stalled download is aborted and finishes with an error, restarted with every received block
+        QTimer *timeout = new QTimer(reply);
+        timeout->setSingleShot(true);
+        QObject::connect(timeout, &QTimer::timeout, reply, &QNetworkReply::abort);
+        QObject::connect(reply, &QNetworkReply::downloadProgress, timeout, [timeout]() { timeout->start(); });
+        timeout->start(TRANSFER_TIMEOUT);
+        m_pending.insert(key);
+    }
+    return QString();
+}
+
+void ArtworkCache::onFinished(QNetworkReply *reply) {
+    reply->deleteLater();
+    QString url = reply->property(URL_PROPERTY).toString();
+    QString key = keyOf(url);
+
+    if (reply->error() != QNetworkReply::NoError) {
+        qCWarning(m_logCategory) << "Cannot load artwork" << reply->errorString();
+        m_pending.remove(key);
+        addFailure(key);
+        emit artworkReady(key, url);
+        return;
+    }
+
+    QFutureWatcher<Stored> *watcher = new QFutureWatcher<Stored>(this);
+    QObject::connect(watcher, &QFutureWatcher<Stored>::finished, this, [this, watcher, key, url]() {
+        watcher->deleteLater();
+        onStored(key, url, watcher->result());
+    });
+    watcher->setFuture(
+        QtConcurrent::run(&ArtworkCache::store, reply->readAll(), m_imageSize, QString(m_directory + "/" + key)));
+}
+
+ArtworkCache::Stored ArtworkCache::store(const QByteArray &data, int imageSize, const QString &baseName) {
+    Stored stored;
+    QImage image;
+    if (!image.loadFromData(data)) {
+        return stored;
+    }
+
+    // only the size shown by the remote is kept
+    if (image.width() > imageSize || image.height() > imageSize) {
+        image = image.scaled(imageSize, imageSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    // JPG has no alpha channel
+    bool      png = image.hasAlphaChannel();
+    QSaveFile file(baseName + (png ? ".png" : ".jpg"));
+    if (!file.open(QIODevice::WriteOnly) || !image.save(&file, png ? "PNG" : "JPG", png ? -1 : 85) ||
+        !file.commit()) {
+        return stored;
+    }
+    stored.fileName = file.fileName();
+    stored.size = QFileInfo(stored.fileName).size();
+    return stored;
+}
+
+void ArtworkCache::onStored(const QString &key, const QString &url, const Stored &stored) {
+    m_pending.remove(key);
+    if (stored.fileName.isEmpty()) {
+        qCWarning(m_logCategory) << "Cannot decode or store artwork" << url;
+        addFailure(key);
+        emit artworkReady(key, url);
+        return;
+    }
+    m_failures.remove(key);
+
+    Entry entry;
+    entry.fileName = stored.fileName;
+    entry.size = stored.size;
+    entry.lastUsed = ++m_useCounter;
+    m_entries.insert(key, entry);
+    m_size += entry.size;
+    evict();
+
+    emit artworkReady(key, QUrl::fromLocalFile(entry.fileName).toString());
+}
+
+void ArtworkCache::addFailure(const QString &key) {
+    if (m_failures.size() >= MAX_FAILURES) {
+        for (QHash<QString, Failure>::iterator iter = m_failures.begin(); iter != m_failures.end();) {
+            if (iter->failed.hasExpired(iter->backoff)) {
+                iter = m_failures.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+    Failure &failure = m_failures[key];
+    failure.backoff = failure.failed.isValid() ? qMin(failure.backoff * 2, RETRY_BACKOFF_MAX) : RETRY_BACKOFF_INITIAL;
+    failure.failed.start();
+}
+
+QString ArtworkCache::keyOf(const QString &url) {
+    QUrl    parsed(url);
+    QString cache = QUrlQuery(parsed).queryItemValue("cache");
+    QString id = cache.isEmpty() ? url : parsed.path() + "?" + cache;
+    return QString::fromLatin1(QCryptographicHash::hash(id.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+void ArtworkCache::loadIndex() {
+    // oldest first, so the last modified images are the most recently used ones
+    QFileInfoList files =
+        QDir(m_directory).entryInfoList(QStringList({"*.jpg", "*.png"}), QDir::Files, QDir::Time | QDir::Reversed);
+    for (int i = 0; i < files.length(); i++) {
+        Entry entry;
+        entry.fileName = files[i].absoluteFilePath();
+        entry.size = files[i].size();
+        entry.lastUsed = ++m_useCounter;
+        m_entries.insert(files[i].completeBaseName(), entry);
+        m_size += entry.size;
+    }
+    evict();
+}
+
+void ArtworkCache::evict() {
+    while (m_size > m_maxSize && !m_entries.isEmpty()) {
+        QHash<QString, Entry>::iterator oldest = m_entries.begin();
+        for (QHash<QString, Entry>::iterator iter = m_entries.begin(); iter != m_entries.end(); ++iter) {
+            if (iter->lastUsed < oldest->lastUsed) {
+                oldest = iter;
+            }
+        }
+        QFile::remove(oldest->fileName);
+        m_size -= oldest->size;
+        m_entries.erase(oldest);
+    }
+}
@@ -0,0 +1,115 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief Downloads media artwork once, downscales it to the display size and keeps it in a size limited disk cache.
+ * The cache index is held in memory and evicts the least recently used images. The decoded images are kept by the
+ * pixmap cache of the QML engine, which loads them by their file URL. Decoding, scaling and encoding run on the
+ * global thread pool. Failed or stalled downloads are retried with a backoff.
+ */
+class ArtworkCache : public QObject {
+    Q_OBJECT
+
+ public:
+    ArtworkCache(const QString& directory, int imageSize, qint64 maxSize, bool ignoreSsl,
+                 const QLoggingCategory& logCategory, QObject* parent = nullptr);
+
+    /**
+     * @brief Returns the local file URL of a cached image and the original URL of an image which failed to download
+     * recently. Otherwise an empty string is returned and the download is started, artworkReady is emitted with the
+     * key of the URL once it is finished.
+     */
+    QString imageUrl(const QString& url);
+
+    /**
+     * @brief Cache key of an image URL. The access token of the Home Assistant media proxy changes regularly and is
+     * not part of the key, its cache parameter identifies the image.
+     */
+    static QString keyOf(const QString& url);
+
+ signals:
+    /**
+     * @brief Emitted with the local file URL, or with the original URL if the image could not be cached
+     */
+    void artworkReady(const QString& key, const QString& imageUrl);
+
+ private slots:
+    void onFinished(QNetworkReply* reply);
+
+ private:
+    /**
+     * @brief A downscaled image stored by a worker thread, the file name is empty if it failed
+     */
+    struct Stored {
+        QString fileName;
+        qint64  size = 0;
+    };
+
+    struct Entry {
+        QString fileName;
+        qint64  size = 0;
+        quint64 lastUsed = 0;
+    };
+
+    /**
+     * @brief A failed download, not retried until the backoff time passed
+     */
+    struct Failure {
+        QElapsedTimer failed;
+        int           backoff = 0;
+    };
+
+    /**
+     * @brief Decodes and downscales an image and stores it as PNG if it has an alpha channel, otherwise as JPG. Runs
+     * on a worker thread.
+     */
+    static Stored store(const QByteArray& data, int imageSize, const QString& baseName);
+
+    void onStored(const QString& key, const QString& url, const Stored& stored);
+    void loadIndex();
+    void evict();
+    void addFailure(const QString& key);
+
+    QNetworkAccessManager*         m_network;
+    QString                        m_directory;
+    int                            m_imageSize;
+    qint64                         m_maxSize;
+    qint64                         m_size = 0;
+    bool                           m_ignoreSsl;
+    quint64                        m_useCounter = 0;
+    QHash<QString, Entry>          m_entries;
+    // downloaded or stored images
+    QSet<QString>                  m_pending;
+    QHash<QString, Failure>        m_failures;
+    const QLoggingCategory&        m_logCategory;
+};
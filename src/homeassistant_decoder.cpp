@@ -0,0 +1,603 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_decoder.h"
+
+#include <cstring>
+
+#include "homeassistant_supportedfeatures.h"
+
+namespace {
+
+// attributes are only decoded for the domains using them
+enum Domains { D_LIGHT = 0x01, D_COVER = 0x02, D_MEDIA_PLAYER = 0x04, D_CLIMATE = 0x08, D_ANY = 0xFF };
+
+struct AttributeDescriptor {
+    const char        *name;
+    EntityState::Field field;
+    int                domains;
+};
+
+const AttributeDescriptor ATTRIBUTES[] = {
+    {"friendly_name", EntityState::FRIENDLY_NAME, D_ANY},
+    {"supported_features", EntityState::SUPPORTED_FEATURES, D_ANY},
+    {"brightness", EntityState::BRIGHTNESS, D_LIGHT},
+    {"rgb_color", EntityState::RGB_COLOR, D_LIGHT},
+    {"color_temp", EntityState::COLOR_TEMP, D_LIGHT},
+    {"current_position", EntityState::CURRENT_POSITION, D_COVER},
+    {"source", EntityState::SOURCE, D_MEDIA_PLAYER},
+    {"volume_level", EntityState::VOLUME_LEVEL, D_MEDIA_PLAYER},
+    {"media_content_type", EntityState::MEDIA_CONTENT_TYPE, D_MEDIA_PLAYER},
+    {"entity_picture", EntityState::ENTITY_PICTURE, D_MEDIA_PLAYER},
+    {"media_title", EntityState::MEDIA_TITLE, D_MEDIA_PLAYER},
+    {"media_artist", EntityState::MEDIA_ARTIST, D_MEDIA_PLAYER},
+    {"current_temperature", EntityState::CURRENT_TEMPERATURE, D_CLIMATE},
+    {"temperature", EntityState::TEMPERATURE, D_CLIMATE},
+    {"max_temp", EntityState::MAX_TEMP, D_CLIMATE},
+    {"min_temp", EntityState::MIN_TEMP, D_CLIMATE},
+    {"hvac_modes", EntityState::HVAC_MODES, D_CLIMATE},
+};
+
+struct HvacModeDescriptor {
+    const char *name;
+    int         mode;
+};
+
+const HvacModeDescriptor HVAC_MODES[] = {
+    {"off", HvacModes::MODE_OFF},
+    {"heat", HvacModes::MODE_HEAT},
+    {"cool", HvacModes::MODE_COOL},
+    {"heat_cool", HvacModes::MODE_HEAT_COOL},
+    {"auto", HvacModes::MODE_AUTO},
+    {"dry", HvacModes::MODE_DRY},
+    {"fan_only", HvacModes::MODE_FAN_ONLY},
+};
+
+const AttributeDescriptor *findAttribute(const JsonReader::Token &key, int domain) {
+    for (const AttributeDescriptor &attribute : ATTRIBUTES) {
+        if ((attribute.domains == D_ANY || (attribute.domains & domain)) &&
+            key.size == static_cast<int>(strlen(attribute.name)) && memcmp(key.data, attribute.name, key.size) == 0) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
+void readAttribute(JsonReader *reader, EntityState::Field field, EntityState *state) {
+    // null values are kept as set attribute with an empty value
+    state->fields |= field;
+    switch (field) {
+        case EntityState::FRIENDLY_NAME:
+            state->friendlyName = reader->readString();
+            break;
+        case EntityState::SUPPORTED_FEATURES:
+            state->supportedFeatures = reader->readInt();
+            break;
+        case EntityState::BRIGHTNESS:
+            state->brightness = reader->readInt();
+            break;
+        case EntityState::RGB_COLOR: {
+            int i = 0;
+            state->rgbColor[0] = state->rgbColor[1] = state->rgbColor[2] = 0;
+            if (reader->beginArray()) {
+                while (reader->nextElement()) {
+                    if (i < 3) {
+                        state->rgbColor[i++] = reader->readInt();
+                    } else {
+                        reader->skipValue();
+                    }
+                }
+            } else {
+                reader->skipValue();
+            }
+            break;
+        }
+        case EntityState::COLOR_TEMP:
+            state->colorTemp = reader->readInt();
+            break;
+        case EntityState::CURRENT_POSITION:
+            state->currentPosition = reader->readInt();
+            break;
+        case EntityState::SOURCE:
+            state->source = reader->readString();
+            break;
+        case EntityState::VOLUME_LEVEL:
+            state->volumeLevel = reader->readDouble();
+            break;
+        case EntityState::MEDIA_CONTENT_TYPE:
+            state->mediaContentType = reader->readString();
+            break;
+        case EntityState::ENTITY_PICTURE:
+            state->entityPicture = reader->readString();
+            break;
+        case EntityState::MEDIA_TITLE:
+            state->mediaTitle = reader->readString();
+            break;
+        case EntityState::MEDIA_ARTIST:
+            state->mediaArtist = reader->readString();
+            break;
+        case EntityState::CURRENT_TEMPERATURE:
+            state->currentTemperature = reader->readDouble();
+            break;
+        case EntityState::TEMPERATURE:
+            state->temperature = reader->readDouble();
+            break;
+        case EntityState::MAX_TEMP:
+            state->maxTemp = reader->readDouble();
+            break;
+        case EntityState::MIN_TEMP:
+            state->minTemp = reader->readDouble();
+            break;
+        case EntityState::HVAC_MODES: {
+            state->hvacModes = 0;
+            if (!reader->beginArray()) {
+                reader->skipValue();
+                break;
+            }
+            JsonReader::Token mode;
+            while (reader->nextElement()) {
+                reader->readToken(&mode);
+                for (const HvacModeDescriptor &descriptor : HVAC_MODES) {
+                    if (mode.size == static_cast<int>(strlen(descriptor.name)) &&
+                        memcmp(mode.data, descriptor.name, mode.size) == 0) {
+                        state->hvacModes |= descriptor.mode;
+                    }
+                }
+            }
+            break;
+        }
+        default:
+            reader->skipValue();
+            break;
+    }
+}
+
+// days since 1970-01-01 of a date of the proleptic Gregorian calendar
+qint64 daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    qint64 era = (year >= 0 ? year : year - 399) / 400;
+    int    yearOfEra = year - static_cast<int>(era * 400);
+    int    dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int    dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+int readDigits(const char *data, int count) {
+    int value = 0;
+    for (int i = 0; i < count; i++) {
+        if (data[i] < '0' || data[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + (data[i] - '0');
+    }
+    return value;
+}
+
+// ISO 8601 timestamp as written by Home Assistant, e.g. 2023-04-01T12:00:00.123456+00:00. Returns false if invalid.
+bool parseTimestamp(const JsonReader::Token &token, double *timestamp) {
+    const char *p = token.data;
+    int         size = token.size;
+    if (size < 19 || p[4] != '-' || p[7] != '-' || (p[10] != 'T' && p[10] != ' ') || p[13] != ':' || p[16] != ':') {
+        return false;
+    }
+    int year = readDigits(p, 4);
+    int month = readDigits(p + 5, 2);
+    int day = readDigits(p + 8, 2);
+    int hour = readDigits(p + 11, 2);
+    int minute = readDigits(p + 14, 2);
+    int second = readDigits(p + 17, 2);
+    if (year < 0 || month < 1 || month > 12 || day < 1 || hour < 0 || minute < 0 || second < 0) {
+        return false;
+    }
+
+    int    i = 19;
+    double fraction = 0;
+    if (i < size && p[i] == '.') {
+        double scale = 0.1;
+        for (i++; i < size && p[i] >= '0' && p[i] <= '9'; i++) {
+            fraction += (p[i] - '0') * scale;
+            scale /= 10;
+        }
+    }
+    int offset = 0;
+    if (i + 6 <= size && (p[i] == '+' || p[i] == '-') && p[i + 3] == ':') {
+        int hours = readDigits(p + i + 1, 2);
+        int minutes = readDigits(p + i + 4, 2);
+        if (hours < 0 || minutes < 0) {
+            return false;
+        }
+        offset = (p[i] == '+' ? 1 : -1) * (hours * 3600 + minutes * 60);
+    }
+
+    qint64 seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+    *timestamp = seconds + fraction;
+    return true;
+}
+
+}  // namespace
+
+void EntityState::merge(const EntityState &other) {
+    if (!other.entityId.isEmpty()) {
+        entityId = other.entityId;
+    }
+    if (other.has(STATE)) {
+        state = other.state;
+    }
+    if (other.has(FRIENDLY_NAME)) {
+        friendlyName = other.friendlyName;
+    }
+    if (other.has(SUPPORTED_FEATURES)) {
+        supportedFeatures = other.supportedFeatures;
+    }
+    if (other.has(BRIGHTNESS)) {
+        brightness = other.brightness;
+    }
+    if (other.has(RGB_COLOR)) {
+        rgbColor[0] = other.rgbColor[0];
+        rgbColor[1] = other.rgbColor[1];
+        rgbColor[2] = other.rgbColor[2];
+    }
+    if (other.has(COLOR_TEMP)) {
+        colorTemp = other.colorTemp;
+    }
+    if (other.has(CURRENT_POSITION)) {
+        currentPosition = other.currentPosition;
+    }
+    if (other.has(SOURCE)) {
+        source = other.source;
+    }
+    if (other.has(VOLUME_LEVEL)) {
+        volumeLevel = other.volumeLevel;
+    }
+    if (other.has(MEDIA_CONTENT_TYPE)) {
+        mediaContentType = other.mediaContentType;
+    }
+    if (other.has(ENTITY_PICTURE)) {
+        entityPicture = other.entityPicture;
+    }
+    if (other.has(MEDIA_TITLE)) {
+        mediaTitle = other.mediaTitle;
+    }
+    if (other.has(MEDIA_ARTIST)) {
+        mediaArtist = other.mediaArtist;
+    }
+    if (other.has(CURRENT_TEMPERATURE)) {
+        currentTemperature = other.currentTemperature;
+    }
+    if (other.has(TEMPERATURE)) {
+        temperature = other.temperature;
+    }
+    if (other.has(MAX_TEMP)) {
+        maxTemp = other.maxTemp;
+    }
+    if (other.has(MIN_TEMP)) {
+        minTemp = other.minTemp;
+    }
+    if (other.has(HVAC_MODES)) {
+        hvacModes = other.hvacModes;
+    }
+    if (other.has(LAST_UPDATED)) {
+        lastUpdated = other.lastUpdated;
+    }
+    fields |= other.fields;
+}
+
+void EntityState::remove(quint32 removedFields) {
+    EntityState empty;
+    empty.fields = removedFields & fields;
+    merge(empty);
+    fields &= ~removedFields;
+}
+
+bool HomeAssistantDecoder::decodeFrame(const QByteArray &frame, QVector<HomeAssistantMessage> *messages) {
+    JsonReader reader(frame);
+
+    if (reader.peek() == JsonReader::ARRAY) {
+        // coalesced messages
+        reader.beginArray();
+        while (reader.nextElement()) {
+            HomeAssistantMessage message;
+            decodeMessage(&reader, &message);
+            messages->append(message);
+        }
+    } else if (reader.peek() == JsonReader::OBJECT) {
+        HomeAssistantMessage message;
+        decodeMessage(&reader, &message);
+        messages->append(message);
+    } else {
+        return false;
+    }
+
+    return !reader.hasError();
+}
+
+void HomeAssistantDecoder::decodeMessage(JsonReader *reader, HomeAssistantMessage *message) {
+    if (!reader->beginObject()) {
+        reader->skipValue();
+        return;
+    }
+
+    JsonReader::Token key;
+    JsonReader::Token value;
+    while (reader->nextKey(&key)) {
+        if (key == "type") {
+            reader->readToken(&value);
+            if (value == "event") {
+                message->type = HomeAssistantMessage::EVENT;
+            } else if (value == "result") {
+                message->type = HomeAssistantMessage::RESULT;
+            } else if (value == "pong") {
+                message->type = HomeAssistantMessage::PONG;
+            } else if (value == "auth_required") {
+                message->type = HomeAssistantMessage::AUTH_REQUIRED;
+            } else if (value == "auth_ok") {
+                message->type = HomeAssistantMessage::AUTH_OK;
+            } else if (value == "auth_invalid") {
+                message->type = HomeAssistantMessage::AUTH_INVALID;
+            }
+        } else if (key == "id") {
+            message->id = reader->readInt();
+        } else if (key == "success") {
+            message->success = reader->readBool();
+        } else if (key == "ha_version") {
+            message->haVersion = reader->readString();
+        } else if (key == "result") {
+            message->result = reader->position();
+            reader->skipValue();
+        } else if (key == "event") {
+            message->event = reader->position();
+            reader->skipValue();
+        } else if (key == "error" && reader->beginObject()) {
+            while (reader->nextKey(&key)) {
+                if (key == "message") {
+                    message->errorMessage = reader->readString();
+                } else {
+                    reader->skipValue();
+                }
+            }
+        } else {
+            reader->skipValue();
+        }
+    }
+}
+
+void HomeAssistantDecoder::decodeState(JsonReader *reader, EntityState *state) {
+    if (!reader->beginObject()) {
+        reader->skipValue();
+        return;
+    }
+
+    JsonReader::Token key;
+    while (reader->nextKey(&key)) {
+        if (key == "entity_id") {
+            state->entityId = reader->readString();
+        } else if (key == "state") {
+            state->state = reader->readString();
+            state->fields |= EntityState::STATE;
+        } else if (key == "attributes") {
+            decodeAttributes(reader, state);
+        } else if (key == "last_updated") {
+            JsonReader::Token value;
+            // a missing or malformed time leaves the state unordered instead of older than any other
+            if (reader->readToken(&value) && parseTimestamp(value, &state->lastUpdated)) {
+                state->fields |= EntityState::LAST_UPDATED;
+            }
+        } else {
+            reader->skipValue();
+        }
+    }
+}
+
+bool HomeAssistantDecoder::decodeStateChangedEvent(const QByteArray &frame, int position, EntityStateChange *change,
+                                                   const QSet<QString> *entityFilter) {
+    JsonReader reader(frame, position);
+    if (!reader.beginObject()) {
+        return false;
+    }
+
+    JsonReader::Token key;
+    while (reader.nextKey(&key)) {
+        if (key != "data" || !reader.beginObject()) {
+            reader.skipValue();
+            continue;
+        }
+        while (reader.nextKey(&key)) {
+            if (key == "entity_id") {
+                change->state.entityId = reader.readString();
+                if (entityFilter && !entityFilter->contains(change->state.entityId)) {
+                    return false;
+                }
+            } else if (key == "new_state") {
+                if (reader.peek() == JsonReader::NULL_VALUE) {
+                    change->kind = EntityStateChange::REMOVED;
+                    reader.skipValue();
+                } else {
+                    change->kind = EntityStateChange::ADDED;
+                    decodeState(&reader, &change->state);
+                }
+            } else {
+                reader.skipValue();
+            }
+        }
+    }
+    if (entityFilter && !entityFilter->contains(change->state.entityId)) {
+        return false;
+    }
+    return !reader.hasError() && !change->state.entityId.isEmpty();
+}
+
+bool HomeAssistantDecoder::decodeCompressedStatesEvent(const QByteArray &frame, int position,
+                                                       QVector<EntityStateChange> *changes) {
+    JsonReader reader(frame, position);
+    if (!reader.beginObject()) {
+        return false;
+    }
+
+    JsonReader::Token key;
+    JsonReader::Token entityKey;
+    while (reader.nextKey(&key)) {
+        if (key == "a" && reader.beginObject()) {
+            // added entities: {"<entity_id>": {"s": state, "a": attributes, ...}}
+            while (reader.nextKey(&entityKey)) {
+                EntityStateChange change;
+                change.kind = EntityStateChange::ADDED;
+                change.state.entityId = QString::fromUtf8(entityKey.data, entityKey.size);
+                decodeCompressedState(&reader, &change.state);
+                changes->append(change);
+            }
+        } else if (key == "c" && reader.beginObject()) {
+            // changed entities: {"<entity_id>": {"+": {"s": state, "a": attributes}, "-": {"a": [attributes]}}}
+            while (reader.nextKey(&entityKey)) {
+                EntityStateChange change;
+                change.kind = EntityStateChange::CHANGED;
+                change.state.entityId = QString::fromUtf8(entityKey.data, entityKey.size);
+                if (!reader.beginObject()) {
+                    reader.skipValue();
+                    continue;
+                }
+                while (reader.nextKey(&key)) {
+                    if (key == "+") {
+                        decodeCompressedState(&reader, &change.state);
+                    } else if (key == "-") {
+                        change.removedFields = decodeRemovedAttributes(&reader, change.state.entityId);
+                    } else {
+                        reader.skipValue();
+                    }
+                }
+                changes->append(change);
+            }
+        } else if (key == "r" && reader.beginArray()) {
+            // removed entities: ["<entity_id>"]
+            while (reader.nextElement()) {
+                EntityStateChange change;
+                change.kind = EntityStateChange::REMOVED;
+                change.state.entityId = reader.readString();
+                changes->append(change);
+            }
+        } else {
+            reader.skipValue();
+        }
+    }
+    return !reader.hasError();
+}
+
+bool HomeAssistantDecoder::isCompressedStatesEvent(const QByteArray &frame, int position) {
+    JsonReader        reader(frame, position);
+    JsonReader::Token key;
+    if (!reader.beginObject() || !reader.nextKey(&key)) {
+        return false;
+    }
+    return key == "a" || key == "c" || key == "r";
+}
+
+void HomeAssistantDecoder::decodeAttributes(JsonReader *reader, EntityState *state) {
+    if (!reader->beginObject()) {
+        reader->skipValue();
+        return;
+    }
+
+    int               domain = domainOf(state->entityId);
+    JsonReader::Token key;
+    while (reader->nextKey(&key)) {
+        const AttributeDescriptor *attribute = findAttribute(key, domain);
+        if (attribute) {
+            readAttribute(reader, attribute->field, state);
+        } else {
+            reader->skipValue();
+        }
+    }
+}
+
+void HomeAssistantDecoder::decodeCompressedState(JsonReader *reader, EntityState *state) {
+    if (!reader->beginObject()) {
+        reader->skipValue();
+        return;
+    }
+
+    // last_updated is only sent if it differs from last_changed
+    double            lastChanged = -1;
+    double            lastUpdated = -1;
+    JsonReader::Token key;
+    while (reader->nextKey(&key)) {
+        if (key == "s") {
+            state->state = reader->readString();
+            state->fields |= EntityState::STATE;
+        } else if (key == "a") {
+            decodeAttributes(reader, state);
+        } else if (key == "lc") {
+            lastChanged = reader->readDouble();
+        } else if (key == "lu") {
+            lastUpdated = reader->readDouble();
+        } else {
+            reader->skipValue();
+        }
+    }
+    if (lastUpdated >= 0 || lastChanged >= 0) {
+        state->lastUpdated = lastUpdated >= 0 ? lastUpdated : lastChanged;
+        state->fields |= EntityState::LAST_UPDATED;
+    }
+}
+
+quint32 HomeAssistantDecoder::decodeRemovedAttributes(JsonReader *reader, const QString &entityId) {
+    quint32 removed = 0;
+    if (!reader->beginObject()) {
+        reader->skipValue();
+        return removed;
+    }
+
+    int               domain = domainOf(entityId);
+    JsonReader::Token key;
+    JsonReader::Token name;
+    while (reader->nextKey(&key)) {
+        if (key != "a" || !reader->beginArray()) {
+            reader->skipValue();
+            continue;
+        }
+        while (reader->nextElement()) {
+            reader->readToken(&name);
+            const AttributeDescriptor *attribute = findAttribute(name, domain);
+            if (attribute) {
+                removed |= attribute->field;
+            }
+        }
+    }
+    return removed;
+}
+
+int HomeAssistantDecoder::domainOf(const QString &entityId) {
+    if (entityId.isEmpty()) {
+        // entity not known yet: decode everything
+        return D_ANY;
+    }
+    if (entityId.startsWith(QLatin1String("light."))) {
+        return D_LIGHT;
+    }
+    if (entityId.startsWith(QLatin1String("cover."))) {
+        return D_COVER;
+    }
+    if (entityId.startsWith(QLatin1String("media_player."))) {
+        return D_MEDIA_PLAYER;
+    }
+    if (entityId.startsWith(QLatin1String("climate."))) {
+        return D_CLIMATE;
+    }
+    // other domains only use the common attributes
+    return 0;
+}
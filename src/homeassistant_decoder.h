@@ -0,0 +1,161 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "homeassistant_jsonreader.h"
+
+/**
+ * @brief Typed state of a Home Assistant entity holding only the attributes used by the supported entity types.
+ * Fields which were not part of the decoded message are not set in the fields mask.
+ */
+struct EntityState {
+    enum Field {
+        STATE               = 0x00001,
+        FRIENDLY_NAME       = 0x00002,
+        SUPPORTED_FEATURES  = 0x00004,
+        BRIGHTNESS          = 0x00008,
+        RGB_COLOR           = 0x00010,
+        COLOR_TEMP          = 0x00020,
+        CURRENT_POSITION    = 0x00040,
+        SOURCE              = 0x00080,
+        VOLUME_LEVEL        = 0x00100,
+        MEDIA_CONTENT_TYPE  = 0x00200,
+        ENTITY_PICTURE      = 0x00400,
+        MEDIA_TITLE         = 0x00800,
+        MEDIA_ARTIST        = 0x01000,
+        CURRENT_TEMPERATURE = 0x02000,
+        TEMPERATURE         = 0x04000,
+        MAX_TEMP            = 0x08000,
+        MIN_TEMP            = 0x10000,
+        LAST_UPDATED        = 0x20000,
+        HVAC_MODES          = 0x40000
+    };
+
+    quint32 fields = 0;
+    QString entityId;
+    QString state;
+    QString friendlyName;
+    int     supportedFeatures = 0;
+    int     brightness = 0;
+    int     rgbColor[3] = {0, 0, 0};
+    int     colorTemp = 0;
+    int     currentPosition = 0;
+    QString source;
+    double  volumeLevel = 0;
+    QString mediaContentType;
+    QString entityPicture;
+    QString mediaTitle;
+    QString mediaArtist;
+    double  currentTemperature = 0;
+    double  temperature = 0;
+    double  maxTemp = 0;
+    double  minTemp = 0;
+    // HvacModes bits
+    int     hvacModes = 0;
+    // seconds since the epoch
+    double  lastUpdated = 0;
+
+    bool has(Field field) const { return fields & field; }
+
+    /**
+     * @brief Takes over all fields which are set in the given state
+     */
+    void merge(const EntityState& other);
+
+    /**
+     * @brief Unsets the given fields and resets their values
+     */
+    void remove(quint32 removedFields);
+};
+
+/**
+ * @brief A message received from Home Assistant. Payloads are not decoded, only their position in the frame is stored.
+ */
+struct HomeAssistantMessage {
+    enum Type { UNKNOWN, AUTH_REQUIRED, AUTH_OK, AUTH_INVALID, RESULT, EVENT, PONG };
+
+    Type    type = UNKNOWN;
+    int     id = 0;
+    bool    success = false;
+    QString haVersion;
+    QString errorMessage;
+    int     result = -1;
+    int     event = -1;
+};
+
+/**
+ * @brief A single entity update decoded from a state_changed event or from a subscribe_entities diff
+ */
+struct EntityStateChange {
+    enum Kind { ADDED, CHANGED, REMOVED };
+
+    Kind        kind = ADDED;
+    EntityState state;
+    quint32     removedFields = 0;
+};
+
+/**
+ * @brief Decodes the Home Assistant websocket messages straight from the UTF-8 frame into typed structures
+ */
+class HomeAssistantDecoder {
+ public:
+    /**
+     * @brief Decodes the message headers of a frame. A frame is either a single message or an array of coalesced
+     * messages.
+     */
+    static bool decodeFrame(const QByteArray& frame, QVector<HomeAssistantMessage>* messages);
+
+    /**
+     * @brief Decodes the full state object the reader is positioned on
+     */
+    static void decodeState(JsonReader* reader, EntityState* state);
+
+    /**
+     * @brief Decodes a state_changed event. A removed entity is returned as REMOVED change.
+     * If an entity filter is given, the new state of other entities is skipped and false is returned.
+     */
+    static bool decodeStateChangedEvent(const QByteArray& frame, int position, EntityStateChange* change,
+                                        const QSet<QString>* entityFilter = nullptr);
+
+    /**
+     * @brief Decodes a subscribe_entities event with added, changed and removed entities
+     */
+    static bool decodeCompressedStatesEvent(const QByteArray& frame, int position,
+                                            QVector<EntityStateChange>* changes);
+
+    /**
+     * @brief Returns true if the event at the given position is a subscribe_entities event, false for a state_changed
+     * event
+     */
+    static bool isCompressedStatesEvent(const QByteArray& frame, int position);
+
+ private:
+    static void    decodeMessage(JsonReader* reader, HomeAssistantMessage* message);
+    static void    decodeAttributes(JsonReader* reader, EntityState* state);
+    static void    decodeCompressedState(JsonReader* reader, EntityState* state);
+    static quint32 decodeRemovedAttributes(JsonReader* reader, const QString& entityId);
+    static int     domainOf(const QString& entityId);
+};
@@ -0,0 +1,299 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_decodeworker.h"
+
+#include <QMutexLocker>
+
+DecodeWorker::DecodeWorker(const QLoggingCategory &logCategory, QObject *parent)
+    : QThread(parent), m_space(m_queue.capacity()), m_logCategory(logCategory) {}
+
+DecodeWorker::~DecodeWorker() {
+    if (isRunning()) {
+        m_stop.storeRelease(1);
+        m_items.release();
+        {
+            QMutexLocker locker(&m_recordsMutex);
+            m_recordsTaken.wakeAll();
+        }
+        wait();
+    }
+}
+
+void DecodeWorker::push(const QString &message) {
+    // the receiving thread is never held back. While the overflow list is used every frame is appended to it to keep
+    // the order, the flag is only set and cleared with the mutex held.
+    bool event = isEventFrame(message);
+    if (m_overflowing.loadAcquire()) {
+        QMutexLocker locker(&m_overflowMutex);
+        if (m_overflowing.loadAcquire()) {
+            hold(message, event);
+            return;
+        }
+    }
+
+    // events leave RESERVED_FRAMES slots free for results, authentication and pong messages, the last slot is always
+    // left for the overflow marker
+    QueuedFrame frame;
+    if (m_space.available() > (event ? RESERVED_FRAMES : 1) && m_space.tryAcquire()) {
+        frame.message = message;
+        m_queue.push(frame);
+        m_items.release();
+        return;
+    }
+
+    // only this thread takes free slots and the last one is free whenever the overflow list is not in use: the marker
+    // taken by the decoder was released before it cleared the flag
+    m_space.acquire();
+    {
+        QMutexLocker locker(&m_overflowMutex);
+        hold(message, event);
+        m_overflowing.storeRelease(1);
+    }
+    frame.overflow = true;
+    m_queue.push(frame);
+    m_items.release();
+}
+
+void DecodeWorker::hold(const QString &message, bool event) {
+    if (!event) {
+        // a message is never dropped, state_changed events before it are not replaced by later ones
+        m_overflowLastMessage = m_overflow.length();
+        m_overflow.append(message);
+        return;
+    }
+
+    // a state_changed event contains the complete new state, a waiting one of the same entity is replaced
+    QString                       entityId = stateChangedEntityId(message);
+    QHash<QString, int>::iterator waiting = m_overflowIndex.find(entityId);
+    if (!entityId.isEmpty() && waiting != m_overflowIndex.end() && waiting.value() > m_overflowLastMessage) {
+        m_overflow[waiting.value()] = message;
+        m_superseded.fetchAndAddRelaxed(1);
+        return;
+    }
+    if (m_overflowEvents >= MAX_OVERFLOW_FRAMES) {
+        m_dropped.fetchAndAddRelaxed(1);
+        m_eventsLost.storeRelease(1);
+        return;
+    }
+    if (!entityId.isEmpty()) {
+        m_overflowIndex.insert(entityId, m_overflow.length());
+    }
+    m_overflowEvents++;
+    m_overflow.append(message);
+    m_overflowed.fetchAndAddRelaxed(1);
+}
+
+void DecodeWorker::run() {
+    QueuedFrame frame;
+    while (true) {
+        m_items.acquire();
+        if (m_stop.loadAcquire()) {
+            return;
+        }
+        m_queue.pop(&frame);
+        m_space.release();
+        if (frame.overflow) {
+            decodeOverflow();
+        } else {
+            decode(frame.message);
+        }
+
+        // reported once the decoder caught up, the states fetched again are not older than the dropped events
+        if (m_items.available() == 0 && m_eventsLost.fetchAndStoreAcquire(0)) {
+            qCWarning(m_logCategory) << "Decoder overloaded, state change events dropped";
+            emit eventsLost();
+        }
+    }
+}
+
+void DecodeWorker::decodeOverflow() {
+    QVector<QString> frames;
+    {
+        QMutexLocker locker(&m_overflowMutex);
+        frames.swap(m_overflow);
+        m_overflowIndex.clear();
+        m_overflowEvents = 0;
+        m_overflowLastMessage = -1;
+        m_overflowing.storeRelease(0);
+    }
+    for (int i = 0; i < frames.length(); i++) {
+        decode(frames[i]);
+    }
+}
+
+bool DecodeWorker::isEventFrame(const QString &message) {
+    // the compact frame of an event starts with {"id":<subscription>,"type":"event". Coalesced arrays may contain
+    // results and are no events.
+    static const QLatin1String ID_KEY("{\"id\":");
+    static const QLatin1String EVENT_TYPE(",\"type\":\"event\"");
+    if (!message.startsWith(ID_KEY)) {
+        return false;
+    }
+    int i = ID_KEY.size();
+    while (i < message.length() && message.at(i).isDigit()) {
+        i++;
+    }
+    return i > ID_KEY.size() && message.midRef(i, EVENT_TYPE.size()) == EVENT_TYPE;
+}
+
+QString DecodeWorker::stateChangedEntityId(const QString &message) {
+    // Home Assistant serializes the event type and the entity id of a state_changed event first
+    static const QLatin1String STATE_CHANGED(
+        ",\"event\":{\"event_type\":\"state_changed\",\"data\":{\"entity_id\":\"");
+    int start = message.indexOf(STATE_CHANGED);
+    if (start < 0) {
+        return QString();
+    }
+    start += STATE_CHANGED.size();
+    int end = message.indexOf('"', start);
+    if (end < 0) {
+        return QString();
+    }
+    return message.mid(start, end - start);
+}
+
+void DecodeWorker::setEntityFilter(const QSet<QString> &entityIds) {
+    QMutexLocker locker(&m_filterMutex);
+    m_entityFilter = entityIds;
+}
+
+void DecodeWorker::decode(const QString &message) {
+    QByteArray                    frame = message.toUtf8();
+    QVector<HomeAssistantMessage> messages;
+    if (!HomeAssistantDecoder::decodeFrame(frame, &messages)) {
+        qCCritical(m_logCategory) << "JSON error: invalid message" << message.left(100);
+        return;
+    }
+
+    QSet<QString> entityFilter;
+    {
+        QMutexLocker locker(&m_filterMutex);
+        entityFilter = m_entityFilter;
+    }
+
+    QVector<DecodedRecord> records;
+    for (int i = 0; i < messages.length(); i++) {
+        const HomeAssistantMessage &decoded = messages[i];
+        if (decoded.type != HomeAssistantMessage::EVENT) {
+            DecodedRecord record;
+            record.kind = DecodedRecord::MESSAGE;
+            record.frame = frame;
+            record.message = decoded;
+            records.append(record);
+            continue;
+        }
+
+        // the subscription id of an event is kept in its message header
+        DecodedRecord record;
+        record.kind = DecodedRecord::STATE_CHANGE;
+        record.message = decoded;
+        if (HomeAssistantDecoder::isCompressedStatesEvent(frame, decoded.event)) {
+            QVector<EntityStateChange> changes;
+            if (!HomeAssistantDecoder::decodeCompressedStatesEvent(frame, decoded.event, &changes)) {
+                qCWarning(m_logCategory) << "Invalid subscribe_entities event";
+            }
+            for (int j = 0; j < changes.length(); j++) {
+                record.change = changes[j];
+                records.append(record);
+            }
+        } else if (HomeAssistantDecoder::decodeStateChangedEvent(frame, decoded.event, &record.change,
+                                                                 &entityFilter)) {
+            records.append(record);
+        }
+    }
+    addRecords(records);
+}
+
+void DecodeWorker::addRecords(const QVector<DecodedRecord> &records) {
+    if (records.isEmpty()) {
+        return;
+    }
+
+    bool notify;
+    {
+        QMutexLocker locker(&m_recordsMutex);
+        if (m_records.length() >= MAX_RECORDS) {
+            // the queue of frames fills up meanwhile
+            m_stalls.fetchAndAddRelaxed(1);
+            while (m_records.length() >= MAX_RECORDS && !m_stop.loadAcquire()) {
+                m_recordsTaken.wait(&m_recordsMutex);
+            }
+        }
+        notify = m_records.isEmpty();
+        for (int i = 0; i < records.length(); i++) {
+            const DecodedRecord &record = records[i];
+            if (record.kind == DecodedRecord::MESSAGE) {
+                m_lastMessage = m_records.length();
+            } else {
+                // a change is only folded into a pending one if no message is handled in between, a result may depend
+                // on the state before it
+                const QString                &entityId = record.change.state.entityId;
+                QHash<QString, int>::iterator pending = m_pendingChanges.find(entityId);
+                if (pending != m_pendingChanges.end() && pending.value() > m_lastMessage) {
+                    DecodedRecord &previous = m_records[pending.value()];
+                    if (previous.message.id == record.message.id && supersede(&previous.change, record.change)) {
+                        m_superseded.fetchAndAddRelaxed(1);
+                        continue;
+                    }
+                }
+                m_pendingChanges.insert(entityId, m_records.length());
+            }
+            m_records.append(record);
+        }
+    }
+
+    // one notification per batch, the records are taken in one go
+    if (notify) {
+        emit recordsReady();
+    }
+}
+
+QVector<DecodedRecord> DecodeWorker::takeRecords() {
+    QMutexLocker           locker(&m_recordsMutex);
+    QVector<DecodedRecord> records;
+    records.swap(m_records);
+    m_pendingChanges.clear();
+    m_lastMessage = -1;
+    m_recordsTaken.wakeAll();
+    return records;
+}
+
+bool DecodeWorker::supersede(EntityStateChange *pending, const EntityStateChange &change) {
+    switch (change.kind) {
+        case EntityStateChange::ADDED:
+        case EntityStateChange::REMOVED:
+            // a complete state or the removal replaces everything pending
+            *pending = change;
+            return true;
+        case EntityStateChange::CHANGED:
+            if (pending->kind == EntityStateChange::REMOVED) {
+                return false;
+            }
+            // attributes removed by the newer diff are dropped, attributes it sets are no longer removed
+            pending->state.remove(change.removedFields);
+            pending->state.merge(change.state);
+            if (pending->kind == EntityStateChange::CHANGED) {
+                pending->removedFields = (pending->removedFields | change.removedFields) & ~change.state.fields;
+            }
+            return true;
+    }
+    return false;
+}
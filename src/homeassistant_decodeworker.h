@@ -0,0 +1,208 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QSemaphore>
+#include <QSet>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "homeassistant_decoder.h"
+
+/**
+ * @brief Bounded lock-free ring buffer for exactly one producer and one consumer thread. One slot stays unused to tell
+ * a full buffer from an empty one.
+ */
+template <typename T, int N>
+class SpscQueue {
+ public:
+    bool push(const T& value) {
+        int tail = m_tail.loadAcquire();
+        int next = (tail + 1) % N;
+        if (next == m_head.loadAcquire()) {
+            return false;
+        }
+        m_items[tail] = value;
+        m_tail.storeRelease(next);
+        return true;
+    }
+
+    bool pop(T* value) {
+        int head = m_head.loadAcquire();
+        if (head == m_tail.loadAcquire()) {
+            return false;
+        }
+        *value = m_items[head];
+        m_items[head] = T();
+        m_head.storeRelease((head + 1) % N);
+        return true;
+    }
+
+    static int capacity() { return N - 1; }
+
+ private:
+    T          m_items[N];
+    QAtomicInt m_head = 0;
+    QAtomicInt m_tail = 0;
+};
+
+/**
+ * @brief A decoded frame: either a message for the integration thread or a state change of a subscription event
+ */
+struct DecodedRecord {
+    enum Kind { MESSAGE, STATE_CHANGE };
+
+    Kind                 kind = MESSAGE;
+    QByteArray           frame;
+    HomeAssistantMessage message;
+    EntityStateChange    change;
+};
+
+/**
+ * @brief Decodes the received frames on its own thread. Events are turned into state change records, other messages
+ * are passed on with their decoded header. Records are collected until the integration thread takes them as a batch,
+ * a pending state change of an entity is superseded by a newer one unless a message record followed it. The decoder
+ * waits while MAX_RECORDS are pending and the frame queue fills up meanwhile.
+ *
+ * Events only use the frame queue up to RESERVED_FRAMES free slots, the rest is kept for results, authentication and
+ * pong messages. Further frames wait in an overflow list which is decoded in order after the queued ones, the last free
+ * slot takes the marker of its position. Messages are never dropped. A state_changed event replaces the waiting one of
+ * its entity, compact subscribe_entities events are kept. Events beyond MAX_OVERFLOW_FRAMES are dropped and eventsLost
+ * is emitted once the decoder caught up.
+ */
+class DecodeWorker : public QThread {
+    Q_OBJECT
+
+ public:
+    // pending records after which the decoder waits for them to be taken, one frame may exceed it
+    static const int MAX_RECORDS = 4096;
+    // free slots of the frame queue only used by frames which are no events
+    static const int RESERVED_FRAMES = 32;
+    // events waiting in the overflow list before further ones are dropped
+    static const int MAX_OVERFLOW_FRAMES = 1024;
+
+    DecodeWorker(const QLoggingCategory& logCategory, QObject* parent = nullptr);
+    ~DecodeWorker() override;
+
+    /**
+     * @brief Queues a received frame. Never blocks: a frame which does not fit into the queue is held back in the
+     * overflow list, only events beyond MAX_OVERFLOW_FRAMES are dropped.
+     */
+    void push(const QString& message);
+
+    /**
+     * @brief Takes all records decoded since the last call
+     */
+    QVector<DecodedRecord> takeRecords();
+
+    /**
+     * @brief Sets the Home Assistant entity ids whose state_changed events are decoded
+     */
+    void setEntityFilter(const QSet<QString>& entityIds);
+
+    quint64 stalls() const { return static_cast<quint64>(m_stalls.loadAcquire()); }
+    quint64 dropped() const { return static_cast<quint64>(m_dropped.loadAcquire()); }
+    quint64 superseded() const { return static_cast<quint64>(m_superseded.loadAcquire()); }
+    quint64 overflowed() const { return static_cast<quint64>(m_overflowed.loadAcquire()); }
+
+ signals:
+    /**
+     * @brief Emitted when records are available after the last takeRecords call
+     */
+    void recordsReady();
+
+    /**
+     * @brief Emitted after decoding the overflow list if events were dropped from it. The state of the entities has to
+     * be fetched again.
+     */
+    void eventsLost();
+
+ protected:
+    void run() override;
+
+ private:
+    /**
+     * @brief Appends a frame to the overflow list, called with the overflow mutex held
+     */
+    void hold(const QString& message, bool event);
+    void decodeOverflow();
+    void decode(const QString& message);
+    void addRecords(const QVector<DecodedRecord>& records);
+
+    /**
+     * @brief Returns true for a single event frame, checked on the compact JSON without decoding it
+     */
+    static bool isEventFrame(const QString& message);
+
+    /**
+     * @brief Returns the entity id of a state_changed event frame, an empty string for other events
+     */
+    static QString stateChangedEntityId(const QString& message);
+
+    /**
+     * @brief Folds a newer change of the same entity into a pending one. Returns false if both have to be applied.
+     */
+    static bool supersede(EntityStateChange* pending, const EntityStateChange& change);
+
+    /**
+     * @brief A slot of the frame queue: a received frame or the position of the overflow list
+     */
+    struct QueuedFrame {
+        QString message;
+        bool    overflow = false;
+    };
+
+    SpscQueue<QueuedFrame, 257> m_queue;
+    QSemaphore                  m_space;
+    QSemaphore                  m_items;
+
+    // frames held back while the frame queue is full, the index of the state_changed event of each entity and of the
+    // last message in it
+    QMutex              m_overflowMutex;
+    QVector<QString>    m_overflow;
+    QHash<QString, int> m_overflowIndex;
+    int                 m_overflowEvents = 0;
+    int                 m_overflowLastMessage = -1;
+    QAtomicInt          m_overflowing = 0;
+    QAtomicInt          m_eventsLost = 0;
+
+    QMutex                 m_filterMutex;
+    QSet<QString>          m_entityFilter;
+    QMutex                 m_recordsMutex;
+    QWaitCondition         m_recordsTaken;
+    QVector<DecodedRecord> m_records;
+    // index of the pending state change record by entity id and of the last message record
+    QHash<QString, int> m_pendingChanges;
+    int                 m_lastMessage = -1;
+
+    QAtomicInt              m_stop = 0;
+    QAtomicInt              m_stalls = 0;
+    QAtomicInt              m_dropped = 0;
+    QAtomicInt              m_superseded = 0;
+    QAtomicInt              m_overflowed = 0;
+    const QLoggingCategory& m_logCategory;
+};
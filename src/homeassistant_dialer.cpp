@@ -0,0 +1,161 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_dialer.h"
+
+#include <QUrl>
+
+EndpointDialer::EndpointDialer(int stagger, int timeout, const QLoggingCategory &logCategory, QObject *parent)
+    : QObject(parent), m_logCategory(logCategory) {
+    m_staggerTimer = new QTimer(this);
+    m_staggerTimer->setSingleShot(true);
+    m_staggerTimer->setInterval(stagger);
+    QObject::connect(m_staggerTimer, &QTimer::timeout, this, &EndpointDialer::startNext);
+
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setSingleShot(true);
+    m_timeoutTimer->setInterval(timeout);
+    QObject::connect(m_timeoutTimer, &QTimer::timeout, this, &EndpointDialer::onTimeout);
+}
+
+void EndpointDialer::dial(const QStringList &urls) {
+    cancel();
+    m_urls = urls;
+    m_next = 0;
+    m_lastError.clear();
+    m_timeoutTimer->start();
+    startNext();
+}
+
+void EndpointDialer::cancel() {
+    m_staggerTimer->stop();
+    m_timeoutTimer->stop();
+    abortAttempts();
+    m_next = m_urls.length();
+}
+
+QString EndpointDialer::websocketUrl(const QString &endpoint, bool ssl) {
+    if (endpoint.contains("://")) {
+        // full URL: the scheme decides about TLS, the websocket path is added if missing
+        QUrl url(endpoint);
+        if (url.scheme() == "https" || url.scheme() == "wss") {
+            url.setScheme("wss");
+        } else {
+            url.setScheme("ws");
+        }
+        if (url.path().isEmpty() || url.path() == "/") {
+            url.setPath("/api/websocket");
+        }
+        return url.toString();
+    }
+    return QString(ssl ? "wss://" : "ws://").append(endpoint).append("/api/websocket");
+}
+
+QString EndpointDialer::httpUrl(const QString &websocketUrl) {
+    QUrl url(websocketUrl);
+    url.setScheme(url.scheme() == "wss" ? "https" : "http");
+    url.setPath(QString());
+    return url.toString();
+}
+
+void EndpointDialer::startNext() {
+    if (m_next >= m_urls.length()) {
+        return;
+    }
+
+    Attempt attempt;
+    attempt.url = m_urls[m_next++];
+    attempt.socket = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+    QWebSocket *socket = attempt.socket;
+    m_attempts.append(attempt);
+
+    QObject::connect(socket, &QWebSocket::connected, this, [this, socket]() { onConnected(socket); });
+    QObject::connect(socket, static_cast<void (QWebSocket::*)(QAbstractSocket::SocketError)>(&QWebSocket::error),
+                     this, [this, socket](QAbstractSocket::SocketError) { onAttemptFailed(socket); });
+    QObject::connect(socket, &QWebSocket::sslErrors, this,
+                     [this, socket](const QList<QSslError> &errors) { emit sslErrors(socket, errors); });
+
+    qCDebug(m_logCategory) << "Connecting to HomeAssistant server:" << attempt.url;
+    socket->open(QUrl(attempt.url));
+    if (m_next < m_urls.length()) {
+        m_staggerTimer->start();
+    }
+}
+
+void EndpointDialer::onConnected(QWebSocket *socket) {
+    QString url;
+    for (int i = 0; i < m_attempts.length(); i++) {
+        if (m_attempts[i].socket == socket) {
+            url = m_attempts[i].url;
+            m_attempts.removeAt(i);
+            break;
+        }
+    }
+    m_staggerTimer->stop();
+    m_timeoutTimer->stop();
+    abortAttempts();
+    m_next = m_urls.length();
+
+    // the winner is handed over without the connections of the dialer
+    QObject::disconnect(socket, nullptr, this, nullptr);
+    socket->setParent(nullptr);
+    qCDebug(m_logCategory) << "Connected to HomeAssistant server:" << url;
+    emit connected(socket, url);
+}
+
+void EndpointDialer::onAttemptFailed(QWebSocket *socket) {
+    for (int i = 0; i < m_attempts.length(); i++) {
+        if (m_attempts[i].socket == socket) {
+            qCDebug(m_logCategory) << "Cannot connect to" << m_attempts[i].url << socket->errorString();
+            m_lastError = socket->errorString();
+            m_attempts.removeAt(i);
+            QObject::disconnect(socket, nullptr, this, nullptr);
+            socket->deleteLater();
+            break;
+        }
+    }
+
+    if (m_next < m_urls.length()) {
+        // no need to wait for the stagger time, the next endpoint is dialed right away
+        m_staggerTimer->stop();
+        startNext();
+    } else if (m_attempts.isEmpty()) {
+        m_timeoutTimer->stop();
+        emit failed(m_lastError);
+    }
+}
+
+void EndpointDialer::onTimeout() {
+    m_staggerTimer->stop();
+    abortAttempts();
+    m_next = m_urls.length();
+    emit failed(tr("Connection timed out"));
+}
+
+void EndpointDialer::abortAttempts() {
+    // the attempts are detached first, aborting emits their error signal
+    QList<Attempt> attempts = m_attempts;
+    m_attempts.clear();
+    for (int i = 0; i < attempts.length(); i++) {
+        QObject::disconnect(attempts[i].socket, nullptr, this, nullptr);
+        attempts[i].socket->abort();
+        attempts[i].socket->deleteLater();
+    }
+}
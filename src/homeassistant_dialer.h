@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QList>
+#include <QLoggingCategory>
+#include <QObject>
+#include <QSslError>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QtWebSockets/QWebSocket>
+
+/**
+ * @brief Dials the configured Home Assistant endpoints in parallel with staggered starts, in order of preference. The
+ * first websocket to complete its handshake wins and the others are aborted.
+ */
+class EndpointDialer : public QObject {
+    Q_OBJECT
+
+ public:
+    EndpointDialer(int stagger, int timeout, const QLoggingCategory& logCategory, QObject* parent = nullptr);
+
+    /**
+     * @brief Starts dialing the websocket URLs, the next one is started after the stagger time or as soon as the
+     * previous one failed. A dial still in progress is cancelled.
+     */
+    void dial(const QStringList& urls);
+    void cancel();
+    bool isDialing() const { return !m_attempts.isEmpty(); }
+
+    /**
+     * @brief Returns the websocket URL of an endpoint given as host and port or as URL
+     */
+    static QString websocketUrl(const QString& endpoint, bool ssl);
+
+    /**
+     * @brief Returns the http(s) base URL of the server of a websocket URL
+     */
+    static QString httpUrl(const QString& websocketUrl);
+
+ signals:
+    /**
+     * @brief Emitted with the connected socket of the winning endpoint, the receiver takes over the socket
+     */
+    void connected(QWebSocket* socket, const QString& url);
+    void failed(const QString& errorString);
+
+    /**
+     * @brief Emitted with the socket of the attempt which has the SSL errors, the receiver may ignore them on it
+     */
+    void sslErrors(QWebSocket* socket, const QList<QSslError>& errors);
+
+ private:
+    struct Attempt {
+        QWebSocket* socket = nullptr;
+        QString     url;
+    };
+
+    void startNext();
+    void onConnected(QWebSocket* socket);
+    void onAttemptFailed(QWebSocket* socket);
+    void onTimeout();
+    void abortAttempts();
+
+    QStringList             m_urls;
+    int                     m_next = 0;
+    QList<Attempt>          m_attempts;
+    QString                 m_lastError;
+    QTimer*                 m_staggerTimer;
+    QTimer*                 m_timeoutTimer;
+    const QLoggingCategory& m_logCategory;
+};
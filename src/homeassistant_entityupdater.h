@@ -0,0 +1,313 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QVariant>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
+#include "homeassistant_decoder.h"
+#include "yio-interface/entities/blindinterface.h"
+#include "yio-interface/entities/climateinterface.h"
+#include "yio-interface/entities/lightinterface.h"
+#include "yio-interface/entities/mediaplayerinterface.h"
+#include "yio-interface/entities/switchinterface.h"
+
+/**
+ * @brief Values last pushed to an entity. Used to suppress updates which would not change anything.
+ */
+struct EntitySnapshot {
+    enum Attribute {
+        STATE,
+        BRIGHTNESS,
+        COLOR,
+        POSITION,
+        VOLUME,
+        SOURCE,
+        MEDIA_TYPE,
+        MEDIA_IMAGE,
+        MEDIA_TITLE,
+        MEDIA_ARTIST,
+        TEMPERATURE,
+        TARGET_TEMPERATURE,
+        TEMPERATURE_MAX,
+        TEMPERATURE_MIN
+    };
+
+    quint32 valid = 0;
+    int     state = 0;
+    int     brightness = 0;
+    // 0xRRGGBB
+    quint32 color = 0;
+    int     position = 0;
+    int     volume = 0;
+    QString source;
+    QString mediaType;
+    QString mediaImage;
+    QString mediaTitle;
+    QString mediaArtist;
+    double  temperature = 0;
+    double  targetTemperature = 0;
+    double  temperatureMax = 0;
+    double  temperatureMin = 0;
+
+    /**
+     * @brief Stores the new value and returns true if it differs from the last one
+     */
+    template <typename T>
+    bool update(Attribute attribute, T* field, const T& value) {
+        quint32 bit = 1u << attribute;
+        if ((valid & bit) && *field == value) {
+            return false;
+        }
+        *field = value;
+        valid |= bit;
+        return true;
+    }
+};
+
+/**
+ * @brief Converts the Home Assistant state of an entity to the YIO state and attributes and pushes the values which
+ * changed. The entity only has to provide entity_id, isSupported, setState and updateAttrByIndex: the integration
+ * uses EntityInterface, the benchmarks a stub.
+ */
+template <typename Entity>
+class EntityUpdater {
+ public:
+    /**
+     * @brief Resolves the URL of a media image to the one pushed to the entity. Returns false if the image is not
+     * available yet, it is pushed later by the integration.
+     */
+    typedef std::function<bool(Entity* entity, const QString& url, QString* imageUrl)> ImageResolver;
+
+    void setHttpUrl(const QString& httpUrl) { m_httpUrl = httpUrl; }
+    void setImageResolver(const ImageResolver& resolver) { m_imageResolver = resolver; }
+
+    void updateLight(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot);
+    void updateBlind(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot);
+    void updateMediaPlayer(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot);
+    void updateClimate(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot);
+    void updateSwitch(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot);
+
+    /**
+     * @brief Sets the entity state or attribute only if the value differs from the last one pushed to the entity
+     */
+    void pushState(Entity* entity, EntitySnapshot* snapshot, int state);
+    template <typename T>
+    void pushAttribute(Entity* entity, EntitySnapshot* snapshot, int attrIndex, EntitySnapshot::Attribute attribute,
+                       T* field, const T& value);
+
+    quint64 pushed() const { return m_pushed; }
+    quint64 suppressed() const { return m_suppressed; }
+
+    static int convertBrightnessToPercentage(float value) { return static_cast<int>(round(value / 255 * 100)); }
+
+ private:
+    QString       m_httpUrl;
+    ImageResolver m_imageResolver;
+    quint64       m_pushed = 0;
+    quint64       m_suppressed = 0;
+};
+
+template <typename Entity>
+void EntityUpdater<Entity>::pushState(Entity* entity, EntitySnapshot* snapshot, int state) {
+    if (snapshot->update(EntitySnapshot::STATE, &snapshot->state, state)) {
+        entity->setState(state);
+        m_pushed++;
+    } else {
+        m_suppressed++;
+    }
+}
+
+template <typename Entity>
+template <typename T>
+void EntityUpdater<Entity>::pushAttribute(Entity* entity, EntitySnapshot* snapshot, int attrIndex,
+                                          EntitySnapshot::Attribute attribute, T* field, const T& value) {
+    if (snapshot->update(attribute, field, value)) {
+        entity->updateAttrByIndex(attrIndex, value);
+        m_pushed++;
+    } else {
+        m_suppressed++;
+    }
+}
+
+template <typename Entity>
+void EntityUpdater<Entity>::updateLight(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot) {
+    // state
+    if (attr.state == "on") {
+        pushState(entity, snapshot, LightDef::ON);
+    } else {
+        pushState(entity, snapshot, LightDef::OFF);
+    }
+
+    // brightness
+    if (entity->isSupported(LightDef::F_BRIGHTNESS)) {
+        int brightness = attr.has(EntityState::BRIGHTNESS) ? convertBrightnessToPercentage(attr.brightness) : 0;
+        pushAttribute(entity, snapshot, LightDef::BRIGHTNESS, EntitySnapshot::BRIGHTNESS, &snapshot->brightness,
+                      brightness);
+    }
+
+    // color
+    if (entity->isSupported(LightDef::F_COLOR)) {
+        quint32 color = (static_cast<quint32>(attr.rgbColor[0] & 0xff) << 16) |
+                        (static_cast<quint32>(attr.rgbColor[1] & 0xff) << 8) |
+                        static_cast<quint32>(attr.rgbColor[2] & 0xff);
+        if (snapshot->update(EntitySnapshot::COLOR, &snapshot->color, color)) {
+            char buffer[10];
+            snprintf(buffer, sizeof(buffer), "#%02X%02X%02X", attr.rgbColor[0], attr.rgbColor[1], attr.rgbColor[2]);
+            entity->updateAttrByIndex(LightDef::COLOR, buffer);
+            m_pushed++;
+        } else {
+            m_suppressed++;
+        }
+    }
+
+    // color temp
+    if (entity->isSupported(LightDef::F_COLORTEMP)) {
+        // FIXME implement me!
+    }
+}
+
+template <typename Entity>
+void EntityUpdater<Entity>::updateBlind(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot) {
+    // state
+    if (attr.state == "open") {
+        pushState(entity, snapshot, BlindDef::OPEN);
+    } else {
+        pushState(entity, snapshot, BlindDef::CLOSED);
+    }
+
+    // position
+    if (entity->isSupported(BlindDef::F_POSITION)) {
+        pushAttribute(entity, snapshot, BlindDef::POSITION, EntitySnapshot::POSITION, &snapshot->position,
+                      100 - attr.currentPosition);
+    }
+}
+
+template <typename Entity>
+void EntityUpdater<Entity>::updateMediaPlayer(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot) {
+    // state
+    const QString& state = attr.state;
+    int            mediaState = MediaPlayerDef::OFF;
+    if (state == "on") {
+        mediaState = MediaPlayerDef::ON;
+    } else if (state == "idle") {
+        mediaState = MediaPlayerDef::IDLE;
+    } else if (state == "playing") {
+        mediaState = MediaPlayerDef::PLAYING;
+    }
+    pushAttribute(entity, snapshot, MediaPlayerDef::STATE, EntitySnapshot::STATE, &snapshot->state, mediaState);
+
+    // source
+    if (entity->isSupported(MediaPlayerDef::F_SOURCE) && attr.has(EntityState::SOURCE)) {
+        pushAttribute(entity, snapshot, MediaPlayerDef::SOURCE, EntitySnapshot::SOURCE, &snapshot->source,
+                      attr.source);
+    }
+
+    // volume
+    if (entity->isSupported(MediaPlayerDef::F_VOLUME_SET) && attr.has(EntityState::VOLUME_LEVEL)) {
+        pushAttribute(entity, snapshot, MediaPlayerDef::VOLUME, EntitySnapshot::VOLUME, &snapshot->volume,
+                      static_cast<int>(round(attr.volumeLevel * 100)));
+    }
+
+    // media type
+    if (entity->isSupported(MediaPlayerDef::F_MEDIA_TYPE) && attr.has(EntityState::MEDIA_CONTENT_TYPE)) {
+        pushAttribute(entity, snapshot, MediaPlayerDef::MEDIATYPE, EntitySnapshot::MEDIA_TYPE, &snapshot->mediaType,
+                      attr.mediaContentType);
+    }
+
+    // media image
+    if (entity->isSupported(MediaPlayerDef::F_MEDIA_IMAGE) && attr.has(EntityState::ENTITY_PICTURE)) {
+        const QString& url = attr.entityPicture;
+        QString        fullUrl = "";
+        if (url.contains("http")) {
+            fullUrl = url;
+        } else if (!url.isEmpty()) {
+            fullUrl = m_httpUrl + url;
+        }
+
+        QString imageUrl = fullUrl;
+        if (!m_imageResolver || m_imageResolver(entity, fullUrl, &imageUrl)) {
+            pushAttribute(entity, snapshot, MediaPlayerDef::MEDIAIMAGE, EntitySnapshot::MEDIA_IMAGE,
+                          &snapshot->mediaImage, imageUrl);
+        }
+    }
+
+    // media title
+    if (entity->isSupported(MediaPlayerDef::F_MEDIA_TITLE) && attr.has(EntityState::MEDIA_TITLE)) {
+        pushAttribute(entity, snapshot, MediaPlayerDef::MEDIATITLE, EntitySnapshot::MEDIA_TITLE,
+                      &snapshot->mediaTitle, attr.mediaTitle);
+    }
+
+    // media artist
+    if (entity->isSupported(MediaPlayerDef::F_MEDIA_ARTIST) && attr.has(EntityState::MEDIA_ARTIST)) {
+        pushAttribute(entity, snapshot, MediaPlayerDef::MEDIAARTIST, EntitySnapshot::MEDIA_ARTIST,
+                      &snapshot->mediaArtist, attr.mediaArtist);
+    }
+}
+
+template <typename Entity>
+void EntityUpdater<Entity>::updateClimate(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot) {
+    // state
+    const QString& state = attr.state;
+    if (state == "off") {
+        pushState(entity, snapshot, ClimateDef::OFF);
+    } else if (state == "heat") {
+        pushState(entity, snapshot, ClimateDef::HEAT);
+    } else if (state == "cool") {
+        pushState(entity, snapshot, ClimateDef::COOL);
+    }
+
+    // current temperature
+    if (entity->isSupported(ClimateDef::F_TEMPERATURE) && attr.has(EntityState::CURRENT_TEMPERATURE)) {
+        pushAttribute(entity, snapshot, ClimateDef::TEMPERATURE, EntitySnapshot::TEMPERATURE,
+                      &snapshot->temperature, attr.currentTemperature);
+    }
+
+    // target temperature
+    if (entity->isSupported(ClimateDef::F_TARGET_TEMPERATURE) && attr.has(EntityState::TEMPERATURE)) {
+        pushAttribute(entity, snapshot, ClimateDef::TARGET_TEMPERATURE, EntitySnapshot::TARGET_TEMPERATURE,
+                      &snapshot->targetTemperature, attr.temperature);
+    }
+
+    // max and min temperatures
+    if (entity->isSupported(ClimateDef::F_TEMPERATURE_MAX) && attr.has(EntityState::MAX_TEMP)) {
+        pushAttribute(entity, snapshot, ClimateDef::TEMPERATURE_MAX, EntitySnapshot::TEMPERATURE_MAX,
+                      &snapshot->temperatureMax, attr.maxTemp);
+    }
+
+    if (entity->isSupported(ClimateDef::F_TEMPERATURE_MIN) && attr.has(EntityState::MIN_TEMP)) {
+        pushAttribute(entity, snapshot, ClimateDef::TEMPERATURE_MIN, EntitySnapshot::TEMPERATURE_MIN,
+                      &snapshot->temperatureMin, attr.minTemp);
+    }
+}
+
+template <typename Entity>
+void EntityUpdater<Entity>::updateSwitch(Entity* entity, const EntityState& attr, EntitySnapshot* snapshot) {
+    // state
+    if (attr.state == "on") {
+        pushState(entity, snapshot, SwitchDef::ON);
+    } else {
+        pushState(entity, snapshot, SwitchDef::OFF);
+    }
+}
@@ -0,0 +1,393 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_jsonreader.h"
+
+#include <math.h>
+
+#include <limits>
+
+JsonReader::JsonReader(const QByteArray &data, int position)
+    : m_data(data.constData()), m_size(data.size()), m_pos(position) {}
+
+bool JsonReader::atEnd() {
+    skipWhitespace();
+    return m_pos >= m_size;
+}
+
+JsonReader::Type JsonReader::peek() {
+    skipWhitespace();
+    if (m_pos >= m_size) {
+        return INVALID;
+    }
+    switch (m_data[m_pos]) {
+        case '{':
+            return OBJECT;
+        case '[':
+            return ARRAY;
+        case '"':
+            return STRING;
+        case 't':
+        case 'f':
+            return BOOLEAN;
+        case 'n':
+            return NULL_VALUE;
+        default:
+            return NUMBER;
+    }
+}
+
+bool JsonReader::beginObject() {
+    if (peek() != OBJECT) {
+        return false;
+    }
+    m_pos++;
+    return true;
+}
+
+bool JsonReader::nextKey(Token *key) {
+    skipWhitespace();
+    if (m_pos < m_size && m_data[m_pos] == ',') {
+        m_pos++;
+        skipWhitespace();
+    }
+    if (m_pos >= m_size) {
+        fail();
+        return false;
+    }
+    if (m_data[m_pos] == '}') {
+        m_pos++;
+        return false;
+    }
+
+    bool escaped;
+    if (!scanString(key, &escaped)) {
+        return false;
+    }
+    skipWhitespace();
+    if (m_pos >= m_size || m_data[m_pos] != ':') {
+        fail();
+        return false;
+    }
+    m_pos++;
+    return true;
+}
+
+bool JsonReader::beginArray() {
+    if (peek() != ARRAY) {
+        return false;
+    }
+    m_pos++;
+    return true;
+}
+
+bool JsonReader::nextElement() {
+    skipWhitespace();
+    if (m_pos < m_size && m_data[m_pos] == ',') {
+        m_pos++;
+        skipWhitespace();
+    }
+    if (m_pos >= m_size) {
+        fail();
+        return false;
+    }
+    if (m_data[m_pos] == ']') {
+        m_pos++;
+        return false;
+    }
+    return true;
+}
+
+bool JsonReader::readToken(Token *token) {
+    if (peek() != STRING) {
+        skipValue();
+        *token = Token();
+        return false;
+    }
+    bool escaped;
+    return scanString(token, &escaped);
+}
+
+QString JsonReader::readString() {
+    if (peek() != STRING) {
+        skipValue();
+        return QString();
+    }
+
+    Token token;
+    bool  escaped;
+    if (!scanString(&token, &escaped)) {
+        return QString();
+    }
+    if (!escaped) {
+        return QString::fromUtf8(token.data, token.size);
+    }
+
+    QByteArray  utf8;
+    const char *p = token.data;
+    const char *end = token.data + token.size;
+    utf8.reserve(token.size);
+    while (p < end) {
+        if (*p != '\\' || p + 1 >= end) {
+            utf8.append(*p++);
+            continue;
+        }
+        p++;
+        switch (*p) {
+            case 'b':
+                utf8.append('\b');
+                break;
+            case 'f':
+                utf8.append('\f');
+                break;
+            case 'n':
+                utf8.append('\n');
+                break;
+            case 'r':
+                utf8.append('\r');
+                break;
+            case 't':
+                utf8.append('\t');
+                break;
+            case 'u': {
+                uint codePoint = 0;
+                for (int i = 1; i <= 4 && p + i < end; i++) {
+                    char c = p[i];
+                    codePoint <<= 4;
+                    if (c >= '0' && c <= '9') {
+                        codePoint |= c - '0';
+                    } else if (c >= 'a' && c <= 'f') {
+                        codePoint |= c - 'a' + 10;
+                    } else if (c >= 'A' && c <= 'F') {
+                        codePoint |= c - 'A' + 10;
+                    }
+                }
+                p += 4;
+                // characters outside the BMP are escaped as a surrogate pair
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF && p + 6 < end && p[1] == '\\' && p[2] == 'u') {
+                    uint low = 0;
+                    for (int i = 3; i <= 6; i++) {
+                        char c = p[i];
+                        low <<= 4;
+                        if (c >= '0' && c <= '9') {
+                            low |= c - '0';
+                        } else if (c >= 'a' && c <= 'f') {
+                            low |= c - 'a' + 10;
+                        } else if (c >= 'A' && c <= 'F') {
+                            low |= c - 'A' + 10;
+                        }
+                    }
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                if (codePoint < 0x80) {
+                    utf8.append(static_cast<char>(codePoint));
+                } else if (codePoint < 0x800) {
+                    utf8.append(static_cast<char>(0xC0 | (codePoint >> 6)));
+                    utf8.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+                } else if (codePoint < 0x10000) {
+                    utf8.append(static_cast<char>(0xE0 | (codePoint >> 12)));
+                    utf8.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                    utf8.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+                } else {
+                    utf8.append(static_cast<char>(0xF0 | (codePoint >> 18)));
+                    utf8.append(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+                    utf8.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                    utf8.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+                }
+                break;
+            }
+            default:
+                // \" \\ \/
+                utf8.append(*p);
+                break;
+        }
+        p++;
+    }
+    return QString::fromUtf8(utf8);
+}
+
+double JsonReader::readDouble() {
+    skipWhitespace();
+    if (m_pos >= m_size) {
+        fail();
+        return 0;
+    }
+    char c = m_data[m_pos];
+    if (c != '-' && (c < '0' || c > '9')) {
+        // null or an unexpected type
+        skipValue();
+        return 0;
+    }
+
+    bool negative = c == '-';
+    if (negative) {
+        m_pos++;
+    }
+
+    // up to 18 significant digits fit into the mantissa, further digits only scale the value
+    quint64 mantissa = 0;
+    int     digits = 0;
+    int     exponent = 0;
+    while (m_pos < m_size && m_data[m_pos] >= '0' && m_data[m_pos] <= '9') {
+        if (digits < 18) {
+            mantissa = mantissa * 10 + static_cast<quint64>(m_data[m_pos] - '0');
+            digits += mantissa > 0 ? 1 : 0;
+        } else {
+            exponent++;
+        }
+        m_pos++;
+    }
+    if (m_pos < m_size && m_data[m_pos] == '.') {
+        m_pos++;
+        while (m_pos < m_size && m_data[m_pos] >= '0' && m_data[m_pos] <= '9') {
+            if (digits < 18) {
+                mantissa = mantissa * 10 + static_cast<quint64>(m_data[m_pos] - '0');
+                digits += mantissa > 0 ? 1 : 0;
+                exponent--;
+            }
+            m_pos++;
+        }
+    }
+    if (m_pos < m_size && (m_data[m_pos] == 'e' || m_data[m_pos] == 'E')) {
+        m_pos++;
+        bool negativeExponent = false;
+        if (m_pos < m_size && (m_data[m_pos] == '-' || m_data[m_pos] == '+')) {
+            negativeExponent = m_data[m_pos] == '-';
+            m_pos++;
+        }
+        int e = 0;
+        while (m_pos < m_size && m_data[m_pos] >= '0' && m_data[m_pos] <= '9') {
+            if (e < 1000) {
+                e = e * 10 + (m_data[m_pos] - '0');
+            }
+            m_pos++;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    // a zero mantissa stays zero, 0 * pow(10, 999) would be NaN
+    double value = static_cast<double>(mantissa);
+    if (value == 0) {
+        return negative ? -0.0 : 0.0;
+    }
+    if (exponent > 0) {
+        value *= pow(10.0, exponent);
+    } else if (exponent < 0) {
+        value /= pow(10.0, -exponent);
+    }
+    return negative ? -value : value;
+}
+
+int JsonReader::readInt() {
+    // numbers beyond the int range are clamped, converting them unchecked is undefined behaviour
+    double value = qBound(static_cast<double>(std::numeric_limits<int>::min()), readDouble(),
+                          static_cast<double>(std::numeric_limits<int>::max()));
+    return static_cast<int>(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+bool JsonReader::readBool() {
+    bool value = peek() == BOOLEAN && m_data[m_pos] == 't';
+    skipValue();
+    return value;
+}
+
+void JsonReader::skipValue() {
+    skipWhitespace();
+    if (m_pos >= m_size) {
+        fail();
+        return;
+    }
+
+    Token token;
+    bool  escaped;
+    char  c = m_data[m_pos];
+    if (c == '"') {
+        scanString(&token, &escaped);
+        return;
+    }
+
+    if (c == '{' || c == '[') {
+        int depth = 0;
+        while (m_pos < m_size) {
+            c = m_data[m_pos];
+            if (c == '"') {
+                if (!scanString(&token, &escaped)) {
+                    return;
+                }
+                continue;
+            }
+            m_pos++;
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return;
+            }
+        }
+        fail();
+        return;
+    }
+
+    // number, true, false or null
+    while (m_pos < m_size) {
+        c = m_data[m_pos];
+        if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            break;
+        }
+        m_pos++;
+    }
+}
+
+void JsonReader::skipWhitespace() {
+    while (m_pos < m_size) {
+        char c = m_data[m_pos];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            break;
+        }
+        m_pos++;
+    }
+}
+
+bool JsonReader::scanString(Token *token, bool *escaped) {
+    if (m_pos >= m_size || m_data[m_pos] != '"') {
+        fail();
+        return false;
+    }
+    int start = ++m_pos;
+    *escaped = false;
+    while (m_pos < m_size) {
+        char c = m_data[m_pos];
+        if (c == '"') {
+            token->data = m_data + start;
+            token->size = m_pos - start;
+            m_pos++;
+            return true;
+        }
+        if (c == '\\') {
+            *escaped = true;
+            m_pos++;
+        }
+        m_pos++;
+    }
+    fail();
+    return false;
+}
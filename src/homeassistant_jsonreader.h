@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <cstring>
+
+/**
+ * @brief Minimal pull parser reading values straight from a UTF-8 encoded JSON buffer.
+ * No document or QVariant tree is built: the caller walks the structure and only converts the values it needs, all
+ * other values are skipped with a plain byte scan. The buffer must outlive the reader.
+ */
+class JsonReader {
+ public:
+    enum Type { INVALID, OBJECT, ARRAY, STRING, NUMBER, BOOLEAN, NULL_VALUE };
+
+    /**
+     * @brief Raw bytes of a string token without the quotes and without unescaping. Used to compare keys and enum-like
+     * values without allocating a QString.
+     */
+    struct Token {
+        const char* data = nullptr;
+        int         size = 0;
+
+        template <int N>
+        bool operator==(const char (&literal)[N]) const {
+            return size == N - 1 && memcmp(data, literal, N - 1) == 0;
+        }
+        template <int N>
+        bool operator!=(const char (&literal)[N]) const {
+            return !(*this == literal);
+        }
+    };
+
+    explicit JsonReader(const QByteArray& data, int position = 0);
+
+    int  position() const { return m_pos; }
+    void seek(int position) { m_pos = position; }
+    bool hasError() const { return m_error; }
+    bool atEnd();
+
+    /**
+     * @brief Returns the type of the next value without consuming it
+     */
+    Type peek();
+
+    /**
+     * @brief Consumes the opening brace of an object. Returns false if the next value is not an object.
+     */
+    bool beginObject();
+
+    /**
+     * @brief Reads the next key of the current object and positions the reader on its value, which must be read or
+     * skipped before the next call. Returns false after consuming the closing brace.
+     */
+    bool nextKey(Token* key);
+
+    /**
+     * @brief Consumes the opening bracket of an array. Returns false if the next value is not an array.
+     */
+    bool beginArray();
+
+    /**
+     * @brief Positions the reader on the next array element, which must be read or skipped before the next call.
+     * Returns false after consuming the closing bracket.
+     */
+    bool nextElement();
+
+    bool    readToken(Token* token);
+    QString readString();
+    double  readDouble();
+    int     readInt();
+    bool    readBool();
+    void    skipValue();
+
+ private:
+    void skipWhitespace();
+    bool scanString(Token* token, bool* escaped);
+    void fail() { m_error = true; m_pos = m_size; }
+
+    const char* m_data;
+    int         m_size;
+    int         m_pos;
+    bool        m_error = false;
+};
@@ -0,0 +1,90 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_latency.h"
+
+#include <QVariantList>
+
+const int LatencyHistogram::BUCKET_BOUNDS[BUCKET_COUNT - 1] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+
+void LatencyHistogram::record(qint64 ms) {
+    if (ms < 0) {
+        ms = 0;
+    }
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && ms > BUCKET_BOUNDS[bucket]) {
+        bucket++;
+    }
+    m_buckets[bucket]++;
+    m_count++;
+    m_sum += static_cast<quint64>(ms);
+    if (ms > m_max) {
+        m_max = ms;
+    }
+}
+
+qint64 LatencyHistogram::quantile(double q) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    quint64 rank = static_cast<quint64>(q * m_count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKET_COUNT - 1; i++) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            return qMin(static_cast<qint64>(BUCKET_BOUNDS[i]), m_max);
+        }
+    }
+    return m_max;
+}
+
+QString LatencyHistogram::summary() const {
+    return QString("n=%1 mean=%2ms p50<=%3ms p90<=%4ms p99<=%5ms max=%6ms")
+        .arg(m_count)
+        .arg(mean())
+        .arg(quantile(0.5))
+        .arg(quantile(0.9))
+        .arg(quantile(0.99))
+        .arg(m_max);
+}
+
+QVariantMap LatencyHistogram::toVariant() const {
+    QVariantList buckets;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        QVariantMap bucket;
+        // the last bucket has no upper bound
+        bucket.insert("le", i < BUCKET_COUNT - 1 ? QVariant(BUCKET_BOUNDS[i]) : QVariant());
+        bucket.insert("count", m_buckets[i]);
+        buckets.append(bucket);
+    }
+
+    QVariantMap map;
+    map.insert("count", m_count);
+    map.insert("mean", mean());
+    map.insert("p50", quantile(0.5));
+    map.insert("p90", quantile(0.9));
+    map.insert("p99", quantile(0.99));
+    map.insert("max", m_max);
+    map.insert("buckets", buckets);
+    return map;
+}
@@ -0,0 +1,59 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QVariant>
+
+/**
+ * @brief Latency distribution in fixed millisecond buckets. Recording is a bucket lookup and an increment, no samples
+ * are stored.
+ */
+class LatencyHistogram {
+ public:
+    // upper bounds of the buckets in ms, the last bucket takes everything above
+    static const int BUCKET_COUNT = 11;
+    static const int BUCKET_BOUNDS[BUCKET_COUNT - 1];
+
+    void record(qint64 ms);
+
+    quint64 count() const { return m_count; }
+    qint64  max() const { return m_max; }
+    qint64  mean() const { return m_count > 0 ? static_cast<qint64>(m_sum / m_count) : 0; }
+
+    /**
+     * @brief Returns the upper bound of the bucket holding the given quantile (0..1). The maximum is returned for the
+     * last bucket.
+     */
+    qint64 quantile(double q) const;
+
+    /**
+     * @brief One line summary with count, mean, median, 90th and 99th percentile and maximum
+     */
+    QString     summary() const;
+    QVariantMap toVariant() const;
+
+ private:
+    quint64 m_buckets[BUCKET_COUNT] = {};
+    quint64 m_count = 0;
+    quint64 m_sum = 0;
+    qint64  m_max = 0;
+};
@@ -0,0 +1,107 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_profiler.h"
+
+#include <QJsonDocument>
+
+#ifdef Q_OS_LINUX
+#include <malloc.h>
+#include <time.h>
+#endif
+
+bool Profiler::enabled() {
+#ifdef HOMEASSISTANT_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Profiler::record(const QString &name, qint64 wallTime, qint64 cpuTime, qint64 heapGrowth) {
+    Counter &counter = m_counters[name];
+    counter.calls++;
+    counter.wallTime += wallTime;
+    counter.cpuTime += cpuTime;
+    // a scope freeing more than it allocates does not offset the growth of other calls
+    if (heapGrowth > 0) {
+        counter.heapGrowth += heapGrowth;
+    }
+}
+
+QVariantMap Profiler::statistics() const {
+    QVariantMap statistics;
+    for (QHash<QString, Counter>::const_iterator iter = m_counters.cbegin(); iter != m_counters.cend(); ++iter) {
+        QVariantMap counter;
+        counter.insert("calls", iter->calls);
+        counter.insert("wall_us", iter->wallTime / 1000);
+        counter.insert("cpu_us", iter->cpuTime / 1000);
+        counter.insert("heap_growth", iter->heapGrowth);
+        statistics.insert(iter.key(), counter);
+    }
+    return statistics;
+}
+
+QString Profiler::summary() const {
+    return QString::fromUtf8(QJsonDocument::fromVariant(statistics()).toJson(QJsonDocument::Compact));
+}
+
+qint64 Profiler::threadCpuTime() {
+#ifdef Q_OS_LINUX
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0) {
+        return static_cast<qint64>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+#endif
+    // no thread CPU clock: the monotonic time since the first call
+    static const QElapsedTimer timer = []() {
+        QElapsedTimer started;
+        started.start();
+        return started;
+    }();
+    return timer.nsecsElapsed();
+}
+
+qint64 Profiler::heapInUse() {
+    // bytes allocated by malloc, including the other threads of the process. Only glibc reports them.
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 info = mallinfo2();
+    return static_cast<qint64>(info.uordblks + info.hblkhd);
+#else
+    // the fields of mallinfo are int and wrap above 2 GB
+    struct mallinfo info = mallinfo();
+    return static_cast<qint64>(static_cast<unsigned int>(info.uordblks)) +
+           static_cast<qint64>(static_cast<unsigned int>(info.hblkhd));
+#endif
+#else
+    return 0;
+#endif
+}
+
+ProfileScope::ProfileScope(Profiler *profiler, const QString &name)
+    : m_profiler(profiler), m_name(name), m_cpuTime(Profiler::threadCpuTime()), m_heap(Profiler::heapInUse()) {
+    m_wallTimer.start();
+}
+
+ProfileScope::~ProfileScope() {
+    m_profiler->record(m_name, m_wallTimer.nsecsElapsed(), Profiler::threadCpuTime() - m_cpuTime,
+                       Profiler::heapInUse() - m_heap);
+}
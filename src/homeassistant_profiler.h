@@ -0,0 +1,94 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QVariant>
+
+/**
+ * @brief Call counts, wall and CPU time and heap growth of instrumented scopes by name. The scopes are only compiled
+ * in with CONFIG+=profiling, which defines HOMEASSISTANT_PROFILING.
+ *
+ * The heap growth is the difference of the malloc heap in use across the scope, not the number or size of the
+ * allocations: memory freed within the scope is not counted and allocations of other threads meanwhile are. Reading
+ * the heap walks all malloc arenas, which costs a few µs per scope and is why profiling is opt-in.
+ */
+class Profiler {
+ public:
+    struct Counter {
+        quint64 calls = 0;
+        qint64  wallTime = 0;
+        qint64  cpuTime = 0;
+        qint64  heapGrowth = 0;
+    };
+
+    static bool enabled();
+
+    void record(const QString &name, qint64 wallTime, qint64 cpuTime, qint64 heapGrowth);
+    void reset() { m_counters.clear(); }
+
+    /**
+     * @brief Returns the counters by scope name with the times in µs and the heap growth in bytes
+     */
+    QVariantMap statistics() const;
+
+    /**
+     * @brief Returns the statistics as a single line of compact JSON
+     */
+    QString summary() const;
+
+    /**
+     * @brief CPU time of the calling thread in ns and heap in use by malloc in bytes. Other platforms than Linux
+     * measure the elapsed time instead of the CPU time, the heap is only reported with glibc and 0 otherwise.
+     */
+    static qint64 threadCpuTime();
+    static qint64 heapInUse();
+
+ private:
+    QHash<QString, Counter> m_counters;
+};
+
+/**
+ * @brief Records the scope from its construction to its destruction
+ */
+class ProfileScope {
+ public:
+    ProfileScope(Profiler *profiler, const QString &name);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+ private:
+    Profiler     *m_profiler;
+    QString       m_name;
+    QElapsedTimer m_wallTimer;
+    qint64        m_cpuTime;
+    qint64        m_heap;
+};
+
+#ifdef HOMEASSISTANT_PROFILING
+#define HOMEASSISTANT_PROFILE_SCOPE(profiler, name) ProfileScope profileScope(profiler, name)
+#else
+#define HOMEASSISTANT_PROFILE_SCOPE(profiler, name)
+#endif
@@ -0,0 +1,47 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_remoteindex.h"
+
+void RemoteIndex::build(const QVariantList &commands) {
+    m_commands = commands;
+    m_codes.clear();
+    m_codes.reserve(commands.length());
+    for (int i = 0; i < commands.length(); i++) {
+        QVariantMap map = commands[i].toMap();
+        QString     feature = map.value("button_map").toString();
+        // the codes of all entries of a button are sent, the device is taken from the first one
+        QHash<QString, RemoteCode>::iterator code = m_codes.find(feature);
+        if (code == m_codes.end()) {
+            code = m_codes.insert(feature, RemoteCode());
+            code->device = map.value("device").toString();
+        }
+        code->codes += map.value("code").toString().split(',');
+    }
+}
+
+const RemoteCode *RemoteIndex::find(const QVariantList &commands, const QString &feature) {
+    // a changed command list is a new list instance, an unknown command is not looked up again
+    if (!commands.isSharedWith(m_commands)) {
+        build(commands);
+    }
+    QHash<QString, RemoteCode>::const_iterator iter = m_codes.constFind(feature);
+    return iter == m_codes.cend() ? nullptr : &iter.value();
+}
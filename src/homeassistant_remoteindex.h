@@ -0,0 +1,55 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+/**
+ * @brief Device and codes of a remote button
+ */
+struct RemoteCode {
+    QString     device;
+    QStringList codes;
+};
+
+/**
+ * @brief Remote buttons by command name and the command list of the remote they were indexed from
+ */
+class RemoteIndex {
+ public:
+    /**
+     * @brief Indexes the button_map entries of the command list of a remote
+     */
+    void build(const QVariantList& commands);
+
+    /**
+     * @brief Returns the codes of a button or nullptr. The index is only rebuilt if the remote returns another command
+     * list, a command is added by setting a new list.
+     */
+    const RemoteCode* find(const QVariantList& commands, const QString& feature);
+
+ private:
+    QVariantList               m_commands;
+    QHash<QString, RemoteCode> m_codes;
+};
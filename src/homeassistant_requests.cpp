@@ -0,0 +1,119 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_requests.h"
+
+#include <QList>
+
+RequestTracker::RequestTracker(QObject *parent) : QObject(parent) {
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setInterval(500);
+    QObject::connect(m_timeoutTimer, &QTimer::timeout, this, &RequestTracker::onCheckTimeouts);
+}
+
+void RequestTracker::reset(const QString &errorMessage) {
+    // the requests are removed before calling back, the callbacks may send new requests
+    QHash<int, Entry> dropped;
+    dropped.swap(m_requests);
+    m_lastId = 0;
+    m_timeoutTimer->stop();
+
+    for (QHash<int, Entry>::iterator iter = dropped.begin(); iter != dropped.end(); ++iter) {
+        Result result;
+        result.request = &iter->request;
+        result.dropped = true;
+        result.errorMessage = errorMessage;
+        result.elapsed = iter->request.sent.elapsed();
+        if (iter->callback) {
+            iter->callback(result);
+        }
+    }
+}
+
+void RequestTracker::track(int id, Kind kind, const QString &entityId, const QString &service, int timeout,
+                           const Callback &callback) {
+    Entry entry;
+    entry.request.id = id;
+    entry.request.kind = kind;
+    entry.request.entityId = entityId;
+    entry.request.service = service;
+    entry.request.timeout = timeout;
+    entry.request.sent.start();
+    entry.callback = callback;
+    m_requests.insert(id, entry);
+
+    if (!m_timeoutTimer->isActive()) {
+        m_timeoutTimer->start();
+    }
+}
+
+bool RequestTracker::complete(const QByteArray &frame, const HomeAssistantMessage &message) {
+    QHash<int, Entry>::iterator iter = m_requests.find(message.id);
+    if (iter == m_requests.end()) {
+        return false;
+    }
+
+    // the request is removed before calling back, the callback may send new requests
+    Entry entry = iter.value();
+    m_requests.erase(iter);
+
+    Result result;
+    result.request = &entry.request;
+    result.success = message.success || message.type == HomeAssistantMessage::PONG;
+    result.errorMessage = message.errorMessage;
+    result.elapsed = entry.request.sent.elapsed();
+    result.frame = &frame;
+    result.message = &message;
+    if (entry.callback) {
+        entry.callback(result);
+    }
+
+    if (m_requests.isEmpty()) {
+        m_timeoutTimer->stop();
+    }
+    return true;
+}
+
+void RequestTracker::onCheckTimeouts() {
+    QList<Entry> expired;
+    for (QHash<int, Entry>::iterator iter = m_requests.begin(); iter != m_requests.end();) {
+        if (iter->request.timeout > 0 && iter->request.sent.hasExpired(iter->request.timeout)) {
+            expired.append(iter.value());
+            iter = m_requests.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    for (int i = 0; i < expired.length(); i++) {
+        Result result;
+        result.request = &expired[i].request;
+        result.timedOut = true;
+        result.errorMessage = "Request timed out";
+        result.elapsed = expired[i].request.sent.elapsed();
+        if (expired[i].callback) {
+            expired[i].callback(result);
+        }
+    }
+
+    if (m_requests.isEmpty()) {
+        m_timeoutTimer->stop();
+    }
+}
@@ -0,0 +1,105 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <functional>
+
+#include "homeassistant_decoder.h"
+
+/**
+ * @brief Keeps track of the requests sent to Home Assistant until their result arrives or they time out.
+ * Message ids are allocated here and correlated with the received result messages.
+ */
+class RequestTracker : public QObject {
+    Q_OBJECT
+
+ public:
+    enum Kind { SUPPORTED_FEATURES, GET_STATES, SUBSCRIBE, UNSUBSCRIBE, CALL_SERVICE, PING };
+
+    struct Request {
+        int           id = 0;
+        Kind          kind = CALL_SERVICE;
+        QString       entityId;
+        // domain.service of a call_service request, the key of its latency histograms
+        QString       service;
+        QElapsedTimer sent;
+        int           timeout = 0;
+    };
+
+    /**
+     * @brief Outcome of a request. Frame and message are only set if a result was received and are only valid during
+     * the callback.
+     */
+    struct Result {
+        const Request*              request = nullptr;
+        bool                        success = false;
+        bool                        timedOut = false;
+        // not answered: dropped or expired in the send queue, or dropped with the connection
+        bool                        dropped = false;
+        QString                     errorMessage;
+        qint64                      elapsed = 0;
+        const QByteArray*           frame = nullptr;
+        const HomeAssistantMessage* message = nullptr;
+    };
+
+    typedef std::function<void(const Result&)> Callback;
+
+    explicit RequestTracker(QObject* parent = nullptr);
+
+    /**
+     * @brief Starts a new connection: message ids start at 1 again and the callbacks of the pending requests are
+     * completed as dropped with the error message
+     */
+    void reset(const QString& errorMessage);
+
+    /**
+     * @brief Allocates the id of the next request
+     */
+    int nextId() { return ++m_lastId; }
+
+    void track(int id, Kind kind, const QString& entityId, const QString& service, int timeout,
+               const Callback& callback);
+
+    /**
+     * @brief Completes the request of a received result or pong message. Returns false for unknown ids.
+     */
+    bool complete(const QByteArray& frame, const HomeAssistantMessage& message);
+
+    int pending() const { return m_requests.size(); }
+
+ private slots:
+    void onCheckTimeouts();
+
+ private:
+    struct Entry {
+        Request  request;
+        Callback callback;
+    };
+
+    int               m_lastId = 0;
+    QHash<int, Entry> m_requests;
+    QTimer*           m_timeoutTimer;
+};
@@ -0,0 +1,98 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_sendqueue.h"
+
+namespace {
+const char *const PRIORITY_NAMES[] = {"heartbeat", "interactive", "resync"};
+}  // namespace
+
+SendQueue::SendQueue(qint64 maxBytes, int interactiveExpiry)
+    : m_maxBytes(maxBytes), m_interactiveExpiry(interactiveExpiry) {}
+
+QList<SendQueue::Message> SendQueue::enqueue(const Message &message) {
+    m_queues[message.priority].enqueue(message);
+    m_queues[message.priority].last().queued.start();
+    m_bytes += message.body.size();
+
+    // the new message itself is never dropped
+    QList<Message>   dropped;
+    QQueue<Message> &interactive = m_queues[INTERACTIVE];
+    while (m_bytes > m_maxBytes && interactive.length() > (message.priority == INTERACTIVE ? 1 : 0)) {
+        dropped.append(interactive.dequeue());
+        m_bytes -= dropped.last().body.size();
+        m_dropped++;
+    }
+    return dropped;
+}
+
+bool SendQueue::takeNext(Message *message, QList<Message> *expired) {
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        QQueue<Message> &queue = m_queues[priority];
+        while (!queue.isEmpty()) {
+            *message = queue.dequeue();
+            m_bytes -= message->body.size();
+            // a key press which could not be sent in time is no longer expected by the user
+            if (priority == INTERACTIVE && message->queued.hasExpired(m_interactiveExpiry)) {
+                expired->append(*message);
+                m_expired++;
+                continue;
+            }
+            m_wait[priority].record(message->queued.elapsed());
+            return true;
+        }
+    }
+    return false;
+}
+
+int SendQueue::depth() const {
+    int depth = 0;
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        depth += m_queues[priority].length();
+    }
+    return depth;
+}
+
+QList<SendQueue::Message> SendQueue::clear() {
+    QList<Message> messages;
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        messages.append(m_queues[priority]);
+        m_queues[priority].clear();
+    }
+    m_bytes = 0;
+    return messages;
+}
+
+QVariantMap SendQueue::statistics() const {
+    QVariantMap depth;
+    QVariantMap wait;
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        depth.insert(PRIORITY_NAMES[priority], m_queues[priority].length());
+        wait.insert(PRIORITY_NAMES[priority], m_wait[priority].toVariant());
+    }
+
+    QVariantMap statistics;
+    statistics.insert("depth", depth);
+    statistics.insert("bytes", m_bytes);
+    statistics.insert("wait", wait);
+    statistics.insert("expired", m_expired);
+    statistics.insert("dropped", m_dropped);
+    return statistics;
+}
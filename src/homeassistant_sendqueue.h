@@ -0,0 +1,87 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QQueue>
+#include <QString>
+#include <QVariant>
+
+#include "homeassistant_latency.h"
+#include "homeassistant_requests.h"
+
+/**
+ * @brief Outgoing requests waiting for the link, sent by priority class. The message id is only assigned when a
+ * request is sent, so the ids on the wire keep increasing. Heartbeat pings are sent ahead of the queued traffic, so
+ * the liveness timeout does not depend on the queue.
+ */
+class SendQueue {
+ public:
+    enum Priority { HEARTBEAT, INTERACTIVE, RESYNC, PRIORITY_COUNT };
+
+    struct Message {
+        Priority                 priority = INTERACTIVE;
+        // the message up to its id, the id and the closing brace are appended when it is sent
+        QString                  body;
+        RequestTracker::Kind     kind = RequestTracker::CALL_SERVICE;
+        QString                  entityId;
+        // domain.service of a call_service request
+        QString                  service;
+        int                      timeout = 0;
+        RequestTracker::Callback callback;
+        QElapsedTimer            queued;
+    };
+
+    explicit SendQueue(qint64 maxBytes = 65536, int interactiveExpiry = 2000);
+
+    /**
+     * @brief Queues a message. Returns the oldest interactive messages which were dropped to stay within the byte
+     * limit. Heartbeat and resync messages are never dropped, the connection depends on them.
+     */
+    QList<Message> enqueue(const Message& message);
+
+    /**
+     * @brief Takes the next message to send. Interactive messages which waited longer than the expiry time are moved
+     * to the expired list instead.
+     */
+    bool takeNext(Message* message, QList<Message>* expired);
+
+    bool   isEmpty() const { return depth() == 0; }
+    int    depth() const;
+    qint64 bytes() const { return m_bytes; }
+
+    /**
+     * @brief Empties the queue and returns the messages in sending order
+     */
+    QList<Message> clear();
+
+    QVariantMap statistics() const;
+
+ private:
+    QQueue<Message>  m_queues[PRIORITY_COUNT];
+    qint64           m_bytes = 0;
+    qint64           m_maxBytes;
+    int              m_interactiveExpiry;
+    LatencyHistogram m_wait[PRIORITY_COUNT];
+    quint64          m_expired = 0;
+    quint64          m_dropped = 0;
+};
@@ -0,0 +1,190 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_serializer.h"
+
+#include <cmath>
+
+CommandSerializer::CommandSerializer() {
+    m_message.reserve(512);
+}
+
+void CommandSerializer::begin(const QString &domain, const QString &service, const QString &entityId) {
+    QHash<QString, Template>           &services = m_templates[domain];
+    QHash<QString, Template>::iterator head = services.find(service);
+    if (head == services.end()) {
+        Template text;
+        text.head = QStringLiteral("{\"type\":\"call_service\",\"domain\":");
+        appendString(&text.head, domain);
+        text.head.append(QLatin1String(",\"service\":"));
+        appendString(&text.head, service);
+        text.head.append(QLatin1String(",\"service_data\":{\"entity_id\":"));
+        text.serviceName = domain + '.' + service;
+        head = services.insert(service, text);
+    }
+
+    // the strings are shared, not copied
+    m_domain = domain;
+    m_serviceName = head->serviceName;
+    m_entityId = entityId;
+
+    // keeps the capacity of the buffer
+    m_message.resize(0);
+    m_message.append(head->head);
+    appendString(&m_message, entityId);
+}
+
+void CommandSerializer::add(const char *key, int value) {
+    appendKey(key);
+    appendInt(&m_message, value);
+}
+
+void CommandSerializer::add(const char *key, double value) {
+    appendKey(key);
+    appendDouble(&m_message, value);
+}
+
+void CommandSerializer::add(const char *key, const QString &value) {
+    appendKey(key);
+    appendString(&m_message, value);
+}
+
+void CommandSerializer::add(const char *key, const QStringList &values) {
+    appendKey(key);
+    m_message.append('[');
+    for (int i = 0; i < values.length(); i++) {
+        if (i > 0) {
+            m_message.append(',');
+        }
+        appendString(&m_message, values[i]);
+    }
+    m_message.append(']');
+}
+
+void CommandSerializer::add(const char *key, const int *values, int count) {
+    appendKey(key);
+    m_message.append('[');
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            m_message.append(',');
+        }
+        appendInt(&m_message, values[i]);
+    }
+    m_message.append(']');
+}
+
+QString &CommandSerializer::finish() {
+    m_message.append(QLatin1String("},\"id\":"));
+    return m_message;
+}
+
+void CommandSerializer::appendKey(const char *key) {
+    m_message.append(QLatin1String(",\""));
+    m_message.append(QLatin1String(key));
+    m_message.append(QLatin1String("\":"));
+}
+
+void CommandSerializer::appendString(QString *out, const QString &value) {
+    static const char HEX[] = "0123456789abcdef";
+
+    out->append('"');
+    const QChar *data = value.constData();
+    int          size = value.size();
+    int          start = 0;
+    for (int i = 0; i < size; i++) {
+        ushort c = data[i].unicode();
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        // copy the plain run before the character which has to be escaped
+        out->append(data + start, i - start);
+        start = i + 1;
+        switch (c) {
+            case '"':
+                out->append(QLatin1String("\\\""));
+                break;
+            case '\\':
+                out->append(QLatin1String("\\\\"));
+                break;
+            case '\n':
+                out->append(QLatin1String("\\n"));
+                break;
+            case '\r':
+                out->append(QLatin1String("\\r"));
+                break;
+            case '\t':
+                out->append(QLatin1String("\\t"));
+                break;
+            default: {
+                char escaped[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                out->append(QLatin1String(escaped, sizeof(escaped)));
+                break;
+            }
+        }
+    }
+    out->append(data + start, size - start);
+    out->append('"');
+}
+
+void CommandSerializer::appendInt(QString *out, qint64 value) {
+    // formatted manually: no temporary string and independent of the locale
+    char    buffer[24];
+    int     pos = sizeof(buffer);
+    quint64 magnitude = value < 0 ? 0 - static_cast<quint64>(value) : static_cast<quint64>(value);
+    do {
+        buffer[--pos] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        buffer[--pos] = '-';
+    }
+    out->append(QLatin1String(buffer + pos, static_cast<int>(sizeof(buffer)) - pos));
+}
+
+void CommandSerializer::appendDouble(QString *out, double value) {
+    if (!std::isfinite(value)) {
+        out->append(QLatin1String("null"));
+        return;
+    }
+    // six decimals are plenty for the service parameters (volume level, temperature), trailing zeros are dropped
+    bool    negative = value < 0;
+    quint64 scaled = static_cast<quint64>(std::fabs(value) * 1000000 + 0.5);
+    quint64 integer = scaled / 1000000;
+    int     fraction = static_cast<int>(scaled % 1000000);
+    if (negative && scaled > 0) {
+        out->append('-');
+    }
+    appendInt(out, static_cast<qint64>(integer));
+    if (fraction == 0) {
+        return;
+    }
+
+    char digits[7];
+    int  length = 6;
+    for (int i = 5; i >= 0; i--) {
+        digits[i] = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+    }
+    while (digits[length - 1] == '0') {
+        length--;
+    }
+    out->append('.');
+    out->append(QLatin1String(digits, length));
+}
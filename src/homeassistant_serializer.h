@@ -0,0 +1,82 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief Writes call_service messages into a reused buffer. The constant head of each domain and service is rendered
+ * once together with the domain.service name, only the entity id, the service data and the message id are written per
+ * command.
+ */
+class CommandSerializer {
+ public:
+    CommandSerializer();
+
+    /**
+     * @brief Starts a new message, invalidating the previous one
+     */
+    void begin(const QString& domain, const QString& service, const QString& entityId);
+
+    void add(const char* key, int value);
+    void add(const char* key, double value);
+    void add(const char* key, const QString& value);
+    void add(const char* key, const QStringList& values);
+    void add(const char* key, const int* values, int count);
+
+    /**
+     * @brief Completes the message up to the value of its id, the sender appends the id and the closing brace. The
+     * returned message is valid until the next call of begin.
+     */
+    QString& finish();
+
+    const QString& domain() const { return m_domain; }
+    const QString& entityId() const { return m_entityId; }
+
+    /**
+     * @brief Returns domain.service of the current message, built once per template
+     */
+    const QString& serviceName() const { return m_serviceName; }
+
+    static void appendString(QString* out, const QString& value);
+    static void appendInt(QString* out, qint64 value);
+    static void appendDouble(QString* out, double value);
+
+ private:
+    /**
+     * @brief Rendered head of the messages of a service and its domain.service name
+     */
+    struct Template {
+        QString head;
+        QString serviceName;
+    };
+
+    void appendKey(const char* key);
+
+    // templates by domain and service, looked up without building a combined key
+    QHash<QString, QHash<QString, Template>> m_templates;
+    QString                                  m_message;
+    QString                                  m_domain;
+    QString                                  m_serviceName;
+    QString                                  m_entityId;
+};
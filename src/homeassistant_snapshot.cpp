@@ -0,0 +1,123 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_snapshot.h"
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QIODevice>
+#include <QSaveFile>
+
+namespace {
+const quint32 MAGIC = 0x48415353;  // "HASS"
+// must be increased whenever the layout of EntityState changes
+const quint16 VERSION = 1;
+// bytes of a serialized EntityState with empty strings, used to check the count against the file size
+const qint64 MIN_STATE_SIZE = 116;
+
+QDataStream &operator<<(QDataStream &stream, const EntityState &state) {
+    stream << state.fields << state.entityId << state.state << state.friendlyName
+           << static_cast<qint32>(state.supportedFeatures) << static_cast<qint32>(state.brightness)
+           << static_cast<qint32>(state.rgbColor[0]) << static_cast<qint32>(state.rgbColor[1])
+           << static_cast<qint32>(state.rgbColor[2]) << static_cast<qint32>(state.colorTemp)
+           << static_cast<qint32>(state.currentPosition) << state.source << state.volumeLevel
+           << state.mediaContentType << state.entityPicture << state.mediaTitle << state.mediaArtist
+           << state.currentTemperature << state.temperature << state.maxTemp << state.minTemp << state.lastUpdated
+           << static_cast<qint32>(state.hvacModes);
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, EntityState &state) {
+    qint32 values[8];
+    stream >> state.fields >> state.entityId >> state.state >> state.friendlyName >> values[0] >> values[1] >>
+        values[2] >> values[3] >> values[4] >> values[5] >> values[6] >> state.source >> state.volumeLevel >>
+        state.mediaContentType >> state.entityPicture >> state.mediaTitle >> state.mediaArtist >>
+        state.currentTemperature >> state.temperature >> state.maxTemp >> state.minTemp >> state.lastUpdated >>
+        values[7];
+    state.supportedFeatures = values[0];
+    state.brightness = values[1];
+    state.rgbColor[0] = values[2];
+    state.rgbColor[1] = values[3];
+    state.rgbColor[2] = values[4];
+    state.colorTemp = values[5];
+    state.currentPosition = values[6];
+    state.hvacModes = values[7];
+    return stream;
+}
+}  // namespace
+
+bool StateSnapshot::read(const QString &fileName, QVector<EntityState> *states) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return false;
+    }
+    uchar *data = file.map(0, file.size());
+    if (data == nullptr) {
+        return false;
+    }
+
+    // the mapped pages are read in place without copying the file
+    QByteArray  buffer = QByteArray::fromRawData(reinterpret_cast<const char *>(data), static_cast<int>(file.size()));
+    QDataStream stream(buffer);
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    // a truncated or corrupt file cannot request more states than its remaining bytes can hold
+    bool valid = magic == MAGIC && version == VERSION && stream.status() == QDataStream::Ok &&
+                 count <= (buffer.size() - stream.device()->pos()) / MIN_STATE_SIZE;
+    if (valid) {
+        states->reserve(static_cast<int>(count));
+        for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+            EntityState state;
+            stream >> state;
+            states->append(state);
+        }
+        valid = stream.status() == QDataStream::Ok;
+    }
+
+    file.unmap(data);
+    if (!valid) {
+        states->clear();
+    }
+    return valid;
+}
+
+bool StateSnapshot::write(const QString &fileName, const QVector<EntityState> &states) {
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << MAGIC << VERSION << static_cast<quint32>(states.length());
+    for (int i = 0; i < states.length(); i++) {
+        stream << states[i];
+    }
+    if (stream.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
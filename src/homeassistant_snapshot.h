@@ -0,0 +1,43 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "homeassistant_decoder.h"
+
+/**
+ * @brief Binary file with the last known states of the managed entities, used to show them right after startup
+ * before the connection to Home Assistant is established.
+ */
+class StateSnapshot {
+ public:
+    /**
+     * @brief Reads the states from a memory mapped snapshot file. Returns false if the file is missing or invalid.
+     */
+    static bool read(const QString& fileName, QVector<EntityState>* states);
+
+    /**
+     * @brief Writes the states to a temporary file which atomically replaces the snapshot file
+     */
+    static bool write(const QString& fileName, const QVector<EntityState>& states);
+};
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeassistant_supportedfeatures.h"
+
+namespace {
+
+constexpr FeatureTable FEATURE_TABLES[] = {featureTable(LIGHT_FEATURE_MAPPINGS), featureTable(BLIND_FEATURE_MAPPINGS),
+                                           featureTable(MEDIA_PLAYER_FEATURE_MAPPINGS),
+                                           featureTable(CLIMATE_FEATURE_MAPPINGS)};
+
+// index into FEATURE_TABLES, -1 for entity types without features
+int tableOf(const QString &entityType) {
+    if (entityType == QLatin1String("light")) {
+        return 0;
+    } else if (entityType == QLatin1String("blind")) {
+        return 1;
+    } else if (entityType == QLatin1String("media_player")) {
+        return 2;
+    } else if (entityType == QLatin1String("climate")) {
+        return 3;
+    }
+    return -1;
+}
+
+}  // namespace
+
+QStringList FeatureMapper::features(const QString &entityType, int supportedFeatures) {
+    int table = tableOf(entityType);
+    if (table < 0) {
+        return QStringList();
+    }
+
+    // entities of the same type and features share one list
+    QPair<int, int>                               key(table, supportedFeatures);
+    QHash<QPair<int, int>, QStringList>::iterator iter = m_lists.find(key);
+    if (iter != m_lists.end()) {
+        return *iter;
+    }
+
+    QStringList         features;
+    const FeatureTable &mappings = FEATURE_TABLES[table];
+    for (int i = 0; i < mappings.count; i++) {
+        const FeatureMapping &mapping = mappings.mappings[i];
+        if (mapping.bit != 0 && !(supportedFeatures & mapping.bit)) {
+            continue;
+        }
+        for (const char *feature : mapping.features) {
+            if (feature && !features.contains(QLatin1String(feature))) {
+                features.append(QLatin1String(feature));
+            }
+        }
+    }
+    m_lists.insert(key, features);
+    return features;
+}
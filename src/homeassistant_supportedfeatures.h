@@ -22,6 +22,10 @@
 
 #pragma once
 
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QStringList>
 #include <QVariant>
 
 class LightFeatures {
@@ -60,10 +64,29 @@ class ClimateFeatures {
         SUPPORT_FAN_MODE                 = 8,
         SUPPORT_PRESET_MODE              = 16,
         SUPPORT_SWING_MODE               = 32,
-        SUPPORT_AUX_HEAT                 = 64
+        SUPPORT_AUX_HEAT                 = 64,
+        SUPPORT_TURN_OFF                 = 128,
+        SUPPORT_TURN_ON                  = 256
     };
 };
 
+/**
+ * @brief HVAC modes of the hvac_modes attribute, passed shifted by HVAC_MODES_SHIFT next to the supported features
+ */
+class HvacModes {
+ public:
+    enum Modes {
+        MODE_OFF       = 1,
+        MODE_HEAT      = 2,
+        MODE_COOL      = 4,
+        MODE_HEAT_COOL = 8,
+        MODE_AUTO      = 16,
+        MODE_DRY       = 32,
+        MODE_FAN_ONLY  = 64
+    };
+    static constexpr int HVAC_MODES_SHIFT = 16;
+};
+
 class MediaPlayerFeatures {
  public:
     enum Features {
@@ -82,6 +105,85 @@ class MediaPlayerFeatures {
         SUPPORT_CLEAR_PLAYLIST    = 8192,
         SUPPORT_PLAY              = 16384,
         SUPPORT_SHUFFLE_SET       = 32768,
-        SUPPORT_SELECT_SOUND_MODE = 65536
+        SUPPORT_SELECT_SOUND_MODE = 65536,
+        SUPPORT_BROWSE_MEDIA      = 131072,
+        SUPPORT_REPEAT_SET        = 262144,
+        SUPPORT_GROUPING          = 524288
     };
 };
+
+/**
+ * @brief YIO features enabled by a Home Assistant feature bit, a mapping without bit is always enabled
+ */
+struct FeatureMapping {
+    int         bit;
+    const char* features[4];
+};
+
+constexpr FeatureMapping LIGHT_FEATURE_MAPPINGS[] = {
+    {LightFeatures::SUPPORT_BRIGHTNESS, {"BRIGHTNESS"}},
+    {LightFeatures::SUPPORT_COLOR, {"COLOR"}},
+    {LightFeatures::SUPPORT_COLOR_TEMP, {"COLORTEMP"}},
+};
+
+constexpr FeatureMapping BLIND_FEATURE_MAPPINGS[] = {
+    {BlindFeatures::SUPPORT_OPEN, {"OPEN"}},
+    {BlindFeatures::SUPPORT_CLOSE, {"CLOSE"}},
+    {BlindFeatures::SUPPORT_STOP, {"STOP"}},
+    {BlindFeatures::SUPPORT_SET_POSITION, {"POSITION"}},
+};
+
+constexpr FeatureMapping CLIMATE_FEATURE_MAPPINGS[] = {
+    {0, {"TEMPERATURE"}},
+    {ClimateFeatures::SUPPORT_TARGET_TEMPERATURE, {"TARGET_TEMPERATURE"}},
+    {ClimateFeatures::SUPPORT_TARGET_TEMPERATURE_RANGE, {"TEMPERATURE_MIN", "TEMPERATURE_MAX"}},
+    {ClimateFeatures::SUPPORT_TURN_ON, {"ON"}},
+    {ClimateFeatures::SUPPORT_TURN_OFF, {"OFF"}},
+    {HvacModes::MODE_OFF << HvacModes::HVAC_MODES_SHIFT, {"OFF"}},
+    {HvacModes::MODE_HEAT << HvacModes::HVAC_MODES_SHIFT, {"HEAT"}},
+    {HvacModes::MODE_COOL << HvacModes::HVAC_MODES_SHIFT, {"COOL"}},
+};
+
+constexpr FeatureMapping MEDIA_PLAYER_FEATURE_MAPPINGS[] = {
+    {0, {"APP_NAME", "MEDIA_ALBUM", "MEDIA_ARTIST", "MEDIA_IMAGE"}},
+    {0, {"MEDIA_TITLE", "MEDIA_TYPE"}},
+    {MediaPlayerFeatures::SUPPORT_PAUSE, {"PAUSE"}},
+    {MediaPlayerFeatures::SUPPORT_SEEK, {"SEEK", "MEDIA_DURATION", "MEDIA_POSITION", "MEDIA_PROGRESS"}},
+    {MediaPlayerFeatures::SUPPORT_VOLUME_SET, {"VOLUME_SET"}},
+    {MediaPlayerFeatures::SUPPORT_VOLUME_MUTE, {"MUTE"}},
+    {MediaPlayerFeatures::SUPPORT_PREVIOUS_TRACK, {"PREVIOUS"}},
+    {MediaPlayerFeatures::SUPPORT_NEXT_TRACK, {"NEXT"}},
+    {MediaPlayerFeatures::SUPPORT_TURN_ON, {"TURN_ON"}},
+    {MediaPlayerFeatures::SUPPORT_TURN_OFF, {"TURN_OFF"}},
+    {MediaPlayerFeatures::SUPPORT_VOLUME_STEP, {"VOLUME_DOWN", "VOLUME_UP"}},
+    {MediaPlayerFeatures::SUPPORT_SELECT_SOURCE, {"SOURCE"}},
+    {MediaPlayerFeatures::SUPPORT_STOP, {"STOP"}},
+    {MediaPlayerFeatures::SUPPORT_PLAY, {"PLAY"}},
+    {MediaPlayerFeatures::SUPPORT_SHUFFLE_SET, {"SHUFFLE"}},
+};
+
+/**
+ * @brief Feature mappings of an entity type
+ */
+struct FeatureTable {
+    const FeatureMapping* mappings;
+    int                   count;
+};
+
+template <int N>
+constexpr FeatureTable featureTable(const FeatureMapping (&mappings)[N]) {
+    return {mappings, N};
+}
+
+/**
+ * @brief Converts Home Assistant feature masks to YIO feature lists with the feature tables. For climate entities the
+ * HVAC modes are passed shifted by HvacModes::HVAC_MODES_SHIFT. The lists are memoized per entity type and feature
+ * mask.
+ */
+class FeatureMapper {
+ public:
+    QStringList features(const QString& entityType, int supportedFeatures);
+
+ private:
+    QHash<QPair<int, int>, QStringList> m_lists;
+};
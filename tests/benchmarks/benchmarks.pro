@@ -0,0 +1,14 @@
+TEMPLATE  = app
+TARGET    = tst_benchmarks
+CONFIG   += c++14 console testcase
+CONFIG   -= app_bundle
+QT       += core testlib
+QT       -= gui
+
+include(../homeassistant-core.pri)
+
+# only the entity definition headers are used, the entity interface is stubbed
+include(../integrations-library.pri)
+INCLUDEPATH += $$INTG_LIB_PATH/src
+
+SOURCES  += tst_benchmarks.cpp
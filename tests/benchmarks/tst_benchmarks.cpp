@@ -0,0 +1,536 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include <QJsonDocument>
+#include <QtTest>
+
+#include "homeassistant_decoder.h"
+#include "homeassistant_entityupdater.h"
+#include "homeassistant_remoteindex.h"
+#include "homeassistant_requests.h"
+#include "homeassistant_sendqueue.h"
+#include "homeassistant_serializer.h"
+#include "homeassistant_supportedfeatures.h"
+
+namespace {
+const int STATES_COUNT = 500;
+
+/**
+ * @brief Stands in for the EntityInterface of a YIO entity: all features are supported, the pushed values are counted
+ */
+class StubEntity {
+ public:
+    explicit StubEntity(const QString &entityId) : m_entityId(entityId) {}
+
+    QString entity_id() const { return m_entityId; }
+    bool    isSupported(int feature) const {
+        Q_UNUSED(feature)
+        return true;
+    }
+    bool setState(int state) {
+        m_state = state;
+        m_updates++;
+        return true;
+    }
+    bool updateAttrByIndex(int attrIndex, const QVariant &value) {
+        Q_UNUSED(attrIndex)
+        m_value = value;
+        m_updates++;
+        return true;
+    }
+    int updates() const { return m_updates; }
+
+ private:
+    QString  m_entityId;
+    int      m_state = 0;
+    QVariant m_value;
+    int      m_updates = 0;
+};
+
+typedef void (EntityUpdater<StubEntity>::*UpdateHandler)(StubEntity *, const EntityState &, EntitySnapshot *);
+
+QByteArray entityState(const char *entityId, const char *state, const char *attributes, int index) {
+    // substituted in one pass, the attributes may contain URL escapes like %3a
+    QString number = QString("%1").arg(index, 6, 10, QChar('0'));
+    return QString("{\"entity_id\":\"%1\",\"state\":\"%2\",\"attributes\":{%3},"
+                   "\"last_changed\":\"2026-10-17T15:00:00.000000+00:00\","
+                   "\"last_updated\":\"2026-10-17T15:00:00.%4+00:00\",\"context\":{\"id\":\"01GQ%4\","
+                   "\"parent_id\":null,\"user_id\":null}}")
+        .arg(QString(entityId), QString(state), QString(attributes), number)
+        .toUtf8();
+}
+
+EntityState decodeState(const QByteArray &json) {
+    EntityState state;
+    JsonReader  reader(json);
+    HomeAssistantDecoder::decodeState(&reader, &state);
+    return state;
+}
+
+QByteArray lightState(int index) {
+    return QString("{\"entity_id\":\"light.room_%1\",\"state\":\"on\",\"attributes\":{\"brightness\":128,"
+                   "\"rgb_color\":[255,200,100],\"color_temp\":300,\"friendly_name\":\"Room %1\","
+                   "\"supported_features\":19},\"last_changed\":\"2026-10-17T15:00:00.000000+00:00\","
+                   "\"last_updated\":\"2026-10-17T15:00:00.%2+00:00\",\"context\":{\"id\":\"01GQ%1\","
+                   "\"parent_id\":null,\"user_id\":null}}")
+        .arg(index)
+        .arg(index % 1000000, 6, 10, QChar('0'))
+        .toUtf8();
+}
+
+QByteArray stateChangedFrame() {
+    return "{\"id\":2,\"type\":\"event\",\"event\":{\"event_type\":\"state_changed\",\"data\":{\"entity_id\":"
+           "\"light.room_1\",\"old_state\":" +
+           lightState(0) + ",\"new_state\":" + lightState(1) +
+           "},\"origin\":\"LOCAL\",\"time_fired\":\"2026-10-17T15:00:00.000001+00:00\",\"context\":{\"id\":"
+           "\"01GQ1\",\"parent_id\":null,\"user_id\":null}}}";
+}
+
+QByteArray compressedStatesFrame() {
+    return "{\"id\":2,\"type\":\"event\",\"event\":{\"c\":{\"light.room_1\":{\"+\":{\"s\":\"on\",\"a\":{"
+           "\"brightness\":200},\"lu\":1792249200.123,\"c\":\"01GQ1\"}},\"media_player.tv\":{\"+\":{\"a\":{"
+           "\"volume_level\":0.35,\"media_title\":\"News\"},\"lu\":1792249200.456},\"-\":{\"a\":["
+           "\"entity_picture\"]}}}}}";
+}
+
+QByteArray statesResultFrame() {
+    QByteArray frame = "{\"id\":3,\"type\":\"result\",\"success\":true,\"result\":[";
+    for (int i = 0; i < STATES_COUNT; i++) {
+        if (i > 0) {
+            frame.append(',');
+        }
+        frame.append(lightState(i));
+    }
+    frame.append("]}");
+    return frame;
+}
+// the former decoding: the frame is converted into a variant tree, the fields are looked up by name
+void decodeVariantState(const QVariantMap &map, EntityState *state) {
+    QVariantMap attributes = map.value("attributes").toMap();
+    state->entityId = map.value("entity_id").toString();
+    state->state = map.value("state").toString();
+    state->friendlyName = attributes.value("friendly_name").toString();
+    state->supportedFeatures = attributes.value("supported_features").toInt();
+    state->brightness = attributes.value("brightness").toInt();
+    QVariantList color = attributes.value("rgb_color").toList();
+    for (int i = 0; i < color.length() && i < 3; i++) {
+        state->rgbColor[i] = color[i].toInt();
+    }
+    state->colorTemp = attributes.value("color_temp").toInt();
+}
+
+// two alternating states of an entity as sent by Home Assistant, every update changes some attributes
+void lightStates(EntityState *states) {
+    const char *ATTRIBUTES[] = {
+        "\"min_mireds\":153,\"max_mireds\":500,\"effect_list\":[\"colorloop\",\"random\"],"
+        "\"supported_color_modes\":[\"color_temp\",\"hs\"],\"color_mode\":\"hs\",\"brightness\":128,"
+        "\"hs_color\":[30.0,60.8],\"rgb_color\":[255,183,100],\"xy_color\":[0.509,0.389],\"color_temp\":null,"
+        "\"friendly_name\":\"Living Room\",\"supported_features\":44",
+        "\"min_mireds\":153,\"max_mireds\":500,\"effect_list\":[\"colorloop\",\"random\"],"
+        "\"supported_color_modes\":[\"color_temp\",\"hs\"],\"color_mode\":\"color_temp\",\"brightness\":230,"
+        "\"hs_color\":[27.0,19.2],\"rgb_color\":[255,227,206],\"xy_color\":[0.386,0.361],\"color_temp\":300,"
+        "\"friendly_name\":\"Living Room\",\"supported_features\":44"};
+    for (int i = 0; i < 2; i++) {
+        states[i] = decodeState(entityState("light.living_room", "on", ATTRIBUTES[i], i));
+    }
+}
+
+void blindStates(EntityState *states) {
+    const char *ATTRIBUTES[] = {
+        "\"current_position\":100,\"device_class\":\"shutter\",\"friendly_name\":\"Terrace\","
+        "\"supported_features\":15",
+        "\"current_position\":35,\"device_class\":\"shutter\",\"friendly_name\":\"Terrace\","
+        "\"supported_features\":15"};
+    const char *STATES[] = {"open", "closed"};
+    for (int i = 0; i < 2; i++) {
+        states[i] = decodeState(entityState("cover.terrace", STATES[i], ATTRIBUTES[i], i));
+    }
+}
+
+void mediaPlayerStates(EntityState *states) {
+    const char *ATTRIBUTES[] = {
+        "\"volume_level\":0.32,\"is_volume_muted\":false,\"media_content_id\":\"x-sonos-spotify:spotify%3atrack"
+        "%3a6rqhFgbbKwnb9MLmUQDhG6?sid=9&flags=8224&sn=3\",\"media_content_type\":\"music\",\"media_duration\":215,"
+        "\"media_position\":42,\"media_position_updated_at\":\"2026-10-17T15:00:00.000000+00:00\","
+        "\"media_title\":\"Speak to Me\",\"media_artist\":\"Pink Floyd\",\"media_album_name\":\"The Dark Side of "
+        "the Moon\",\"shuffle\":false,\"repeat\":\"off\",\"queue_position\":1,\"queue_size\":10,"
+        "\"source_list\":[\"Line-in\",\"TV\",\"Radio Paradise\",\"Spotify\"],\"source\":\"Spotify\","
+        "\"group_members\":[\"media_player.living_room\",\"media_player.kitchen\"],\"entity_picture\":"
+        "\"/api/media_player_proxy/media_player.living_room?token=8a4c1e2f&cache=1a2b3c4d\","
+        "\"friendly_name\":\"Living Room\",\"supported_features\":4127295",
+        "\"volume_level\":0.35,\"is_volume_muted\":false,\"media_content_id\":\"x-sonos-spotify:spotify%3atrack"
+        "%3a05uGBKRCuePsf43Hfm0JwX?sid=9&flags=8224&sn=3\",\"media_content_type\":\"music\",\"media_duration\":163,"
+        "\"media_position\":0,\"media_position_updated_at\":\"2026-10-17T15:03:35.000000+00:00\","
+        "\"media_title\":\"Breathe (In the Air)\",\"media_artist\":\"Pink Floyd\",\"media_album_name\":\"The "
+        "Dark Side of the Moon\",\"shuffle\":false,\"repeat\":\"off\",\"queue_position\":2,\"queue_size\":10,"
+        "\"source_list\":[\"Line-in\",\"TV\",\"Radio Paradise\",\"Spotify\"],\"source\":\"Spotify\","
+        "\"group_members\":[\"media_player.living_room\",\"media_player.kitchen\"],\"entity_picture\":"
+        "\"/api/media_player_proxy/media_player.living_room?token=8a4c1e2f&cache=5e6f7a8b\","
+        "\"friendly_name\":\"Living Room\",\"supported_features\":4127295"};
+    for (int i = 0; i < 2; i++) {
+        states[i] = decodeState(entityState("media_player.living_room", "playing", ATTRIBUTES[i], i));
+    }
+}
+
+void climateStates(EntityState *states) {
+    const char *ATTRIBUTES[] = {
+        "\"hvac_modes\":[\"off\",\"heat\",\"cool\",\"auto\"],\"min_temp\":7,\"max_temp\":35,"
+        "\"target_temp_step\":0.5,\"preset_modes\":[\"none\",\"away\",\"boost\",\"eco\"],"
+        "\"current_temperature\":20.5,\"temperature\":21.5,\"current_humidity\":45,\"hvac_action\":\"heating\","
+        "\"preset_mode\":\"none\",\"friendly_name\":\"Hallway\",\"supported_features\":401",
+        "\"hvac_modes\":[\"off\",\"heat\",\"cool\",\"auto\"],\"min_temp\":7,\"max_temp\":35,"
+        "\"target_temp_step\":0.5,\"preset_modes\":[\"none\",\"away\",\"boost\",\"eco\"],"
+        "\"current_temperature\":23.0,\"temperature\":22.0,\"current_humidity\":52,\"hvac_action\":\"cooling\","
+        "\"preset_mode\":\"eco\",\"friendly_name\":\"Hallway\",\"supported_features\":401"};
+    const char *STATES[] = {"heat", "cool"};
+    for (int i = 0; i < 2; i++) {
+        states[i] = decodeState(entityState("climate.hallway", STATES[i], ATTRIBUTES[i], i));
+    }
+}
+
+void switchStates(EntityState *states) {
+    const char *ATTRIBUTES = "\"friendly_name\":\"Coffee Machine\"";
+    const char *STATES[] = {"on", "off"};
+    for (int i = 0; i < 2; i++) {
+        states[i] = decodeState(entityState("switch.coffee_machine", STATES[i], ATTRIBUTES, i));
+    }
+}
+
+QVariantList remoteCommands() {
+    // a learned TV remote: some buttons send a sequence of codes
+    const char *BUTTONS[] = {"POWER_ON",    "POWER_OFF", "VOLUME_UP",   "VOLUME_DOWN",  "MUTE_TOGGLE", "CHANNEL_UP",
+                             "CHANNEL_DOWN", "CURSOR_UP", "CURSOR_DOWN", "CURSOR_LEFT",  "CURSOR_RIGHT", "CURSOR_OK",
+                             "BACK",        "HOME",      "MENU",        "INFO",         "GUIDE",        "DIGIT_0",
+                             "DIGIT_1",     "DIGIT_2",   "DIGIT_3",     "DIGIT_4",      "DIGIT_5",      "DIGIT_6",
+                             "DIGIT_7",     "DIGIT_8",   "DIGIT_9",     "INPUT_SOURCE", "PLAY",         "PAUSE"};
+    QVariantList commands;
+    for (int i = 0; i < 60; i++) {
+        QVariantMap command;
+        command.insert("button_map", BUTTONS[i % 30]);
+        command.insert("code", QString("0x20DF%1EF,0x20DF%1EF").arg(i, 2, 16, QChar('0')));
+        command.insert("device", "living_room_tv");
+        commands.append(command);
+    }
+    return commands;
+}
+
+void addDecoderRows() {
+    QTest::addColumn<bool>("document");
+    QTest::newRow("JsonReader") << false;
+    QTest::newRow("QJsonDocument") << true;
+}
+}  // namespace
+
+/**
+ * @brief Throughput of the hot paths of the integration: decoding the received messages, updating the entities,
+ * serializing commands and correlating requests. The decoders and the serializer are compared with the former
+ * QJsonDocument conversion. Run with ./tst_benchmarks [-iterations n | -callgrind | -tickcounter].
+ *
+ * Heap allocations are not counted here, replacing the allocator breaks sanitizers and other C libraries. Run a single
+ * benchmark under heaptrack or valgrind with -iterations 1000 and -iterations 2000 instead: the difference of the
+ * allocation counts divided by 1000 is the number of allocations per operation.
+ */
+class Benchmarks : public QObject {
+    Q_OBJECT
+
+ private slots:
+    void decodeStateChangedEvent_data() { addDecoderRows(); }
+    void decodeStateChangedEvent();
+    void decodeCompressedStatesEvent();
+    void decodeStates_data() { addDecoderRows(); }
+    void decodeStates();
+    void serializeCommand_data();
+    void serializeCommand();
+    void requestTracker();
+    void sendQueue();
+    void updateLight();
+    void updateBlind();
+    void updateMediaPlayer();
+    void updateClimate();
+    void updateSwitch();
+    void supportedFeatures();
+    void findRemoteCodes();
+
+ private:
+    /**
+     * @brief Applies two alternating states to a stub entity, every update pushes the changed values
+     */
+    void benchmarkUpdate(UpdateHandler handler, const EntityState *states);
+
+    /**
+     * @brief Returns the number of values pushed by the second state after the first one
+     */
+    static int changedValues(UpdateHandler handler, const EntityState *states);
+};
+
+void Benchmarks::decodeStateChangedEvent() {
+    QByteArray                    frame = stateChangedFrame();
+    QVector<HomeAssistantMessage> decoded;
+    EntityStateChange             decodedChange;
+    QVERIFY(HomeAssistantDecoder::decodeFrame(frame, &decoded));
+    QVERIFY(HomeAssistantDecoder::decodeStateChangedEvent(frame, decoded[0].event, &decodedChange));
+    QCOMPARE(decodedChange.state.entityId, QString("light.room_1"));
+    QVERIFY(decodedChange.state.has(EntityState::LAST_UPDATED));
+
+    QFETCH(bool, document);
+    if (document) {
+        QBENCHMARK {
+            QVariantMap map = QJsonDocument::fromJson(frame).toVariant().toMap();
+            QVariantMap data = map.value("event").toMap().value("data").toMap();
+            EntityStateChange change;
+            decodeVariantState(data.value("new_state").toMap(), &change.state);
+        }
+        return;
+    }
+    QBENCHMARK {
+        QVector<HomeAssistantMessage> messages;
+        HomeAssistantDecoder::decodeFrame(frame, &messages);
+        EntityStateChange change;
+        HomeAssistantDecoder::decodeStateChangedEvent(frame, messages[0].event, &change);
+    }
+}
+
+void Benchmarks::decodeCompressedStatesEvent() {
+    QByteArray                    frame = compressedStatesFrame();
+    QVector<HomeAssistantMessage> decoded;
+    QVector<EntityStateChange>    decodedChanges;
+    QVERIFY(HomeAssistantDecoder::decodeFrame(frame, &decoded));
+    QVERIFY(HomeAssistantDecoder::decodeCompressedStatesEvent(frame, decoded[0].event, &decodedChanges));
+    QCOMPARE(decodedChanges.length(), 2);
+    QBENCHMARK {
+        QVector<HomeAssistantMessage> messages;
+        HomeAssistantDecoder::decodeFrame(frame, &messages);
+        QVector<EntityStateChange> changes;
+        HomeAssistantDecoder::decodeCompressedStatesEvent(frame, messages[0].event, &changes);
+    }
+}
+
+void Benchmarks::decodeStates() {
+    QByteArray                    frame = statesResultFrame();
+    QVector<HomeAssistantMessage> decoded;
+    QVERIFY(HomeAssistantDecoder::decodeFrame(frame, &decoded));
+    QCOMPARE(decoded[0].type, HomeAssistantMessage::RESULT);
+
+    QFETCH(bool, document);
+    if (document) {
+        QBENCHMARK {
+            QVariantList list = QJsonDocument::fromJson(frame).toVariant().toMap().value("result").toList();
+            for (int i = 0; i < list.length(); i++) {
+                EntityState state;
+                decodeVariantState(list[i].toMap(), &state);
+            }
+        }
+        return;
+    }
+    QBENCHMARK {
+        QVector<HomeAssistantMessage> messages;
+        HomeAssistantDecoder::decodeFrame(frame, &messages);
+        JsonReader reader(frame, messages[0].result);
+        reader.beginArray();
+        while (reader.nextElement()) {
+            EntityState state;
+            HomeAssistantDecoder::decodeState(&reader, &state);
+        }
+    }
+}
+
+void Benchmarks::serializeCommand_data() {
+    QTest::addColumn<bool>("document");
+    QTest::newRow("CommandSerializer") << false;
+    QTest::newRow("QJsonDocument") << true;
+}
+
+void Benchmarks::serializeCommand() {
+    // a light turn_on with brightness
+    const QString     domain = QStringLiteral("light");
+    const QString     service = QStringLiteral("turn_on");
+    const QString     entityId = QStringLiteral("light.living_room");
+    CommandSerializer serializer;
+    int               id = 0;
+
+    QFETCH(bool, document);
+    if (document) {
+        // the former conversion: built as variant map and converted with QJsonDocument
+        QBENCHMARK {
+            QVariantMap data;
+            data.insert("brightness_pct", 50);
+            data.insert("entity_id", QVariant(entityId));
+            QVariantMap map;
+            map.insert("id", QVariant(++id));
+            map.insert("type", QVariant("call_service"));
+            map.insert("domain", QVariant(domain));
+            map.insert("service", QVariant(service));
+            map.insert("service_data", data);
+            QString message = QJsonDocument::fromVariant(map).toJson(QJsonDocument::JsonFormat::Compact);
+        }
+        return;
+    }
+    QBENCHMARK {
+        serializer.begin(domain, service, entityId);
+        serializer.add("brightness_pct", 50);
+        QString &message = serializer.finish();
+        CommandSerializer::appendInt(&message, ++id);
+        message.append('}');
+    }
+}
+
+void Benchmarks::requestTracker() {
+    // ids are allocated at send time and completed by the result messages
+    RequestTracker       tracker;
+    HomeAssistantMessage message;
+    message.type = HomeAssistantMessage::RESULT;
+    message.success = true;
+    QByteArray frame;
+    int        id = 0;
+    QBENCHMARK {
+        for (int i = 0; i < 100; i++) {
+            id = tracker.nextId();
+            tracker.track(id, RequestTracker::CALL_SERVICE, "light.living_room", "light.turn_on", 10000,
+                          [](const RequestTracker::Result &) {});
+        }
+        // the results arrive in sending order
+        for (message.id = id - 99; message.id <= id; message.id++) {
+            tracker.complete(frame, message);
+        }
+    }
+}
+
+void Benchmarks::sendQueue() {
+    // a burst of commands, resync requests and a ping which is drained by priority
+    SendQueue::Message message;
+    message.body = QStringLiteral("{\"type\":\"call_service\",\"domain\":\"light\",\"service\":\"turn_on\","
+                                  "\"service_data\":{\"entity_id\":\"light.living_room\"},\"id\":");
+    SendQueue queue;
+    QBENCHMARK {
+        for (int i = 0; i < 100; i++) {
+            message.priority = static_cast<SendQueue::Priority>(i % SendQueue::PRIORITY_COUNT);
+            queue.enqueue(message);
+        }
+        QList<SendQueue::Message> expired;
+        SendQueue::Message        next;
+        while (queue.takeNext(&next, &expired)) {
+        }
+    }
+}
+
+void Benchmarks::benchmarkUpdate(UpdateHandler handler, const EntityState *states) {
+    EntityUpdater<StubEntity> updater;
+    updater.setHttpUrl(QStringLiteral("http://192.168.1.10:8123"));
+    StubEntity     entity(states[0].entityId);
+    EntitySnapshot snapshot;
+    int            i = 0;
+    QBENCHMARK {
+        (updater.*handler)(&entity, states[i++ & 1], &snapshot);
+    }
+}
+
+int Benchmarks::changedValues(UpdateHandler handler, const EntityState *states) {
+    EntityUpdater<StubEntity> updater;
+    updater.setHttpUrl(QStringLiteral("http://192.168.1.10:8123"));
+    StubEntity     entity(states[0].entityId);
+    EntitySnapshot snapshot;
+    (updater.*handler)(&entity, states[0], &snapshot);
+    int initial = entity.updates();
+    (updater.*handler)(&entity, states[1], &snapshot);
+    return entity.updates() - initial;
+}
+
+void Benchmarks::updateLight() {
+    EntityState states[2];
+    lightStates(states);
+    QVERIFY(changedValues(&EntityUpdater<StubEntity>::updateLight, states) > 0);
+    benchmarkUpdate(&EntityUpdater<StubEntity>::updateLight, states);
+}
+
+void Benchmarks::updateBlind() {
+    EntityState states[2];
+    blindStates(states);
+    QVERIFY(changedValues(&EntityUpdater<StubEntity>::updateBlind, states) > 0);
+    benchmarkUpdate(&EntityUpdater<StubEntity>::updateBlind, states);
+}
+
+void Benchmarks::updateMediaPlayer() {
+    EntityState states[2];
+    mediaPlayerStates(states);
+    QVERIFY(states[1].has(EntityState::ENTITY_PICTURE));
+    QVERIFY(changedValues(&EntityUpdater<StubEntity>::updateMediaPlayer, states) > 0);
+    benchmarkUpdate(&EntityUpdater<StubEntity>::updateMediaPlayer, states);
+}
+
+void Benchmarks::updateClimate() {
+    EntityState states[2];
+    climateStates(states);
+    QVERIFY(states[0].has(EntityState::HVAC_MODES));
+    QVERIFY(changedValues(&EntityUpdater<StubEntity>::updateClimate, states) > 0);
+    benchmarkUpdate(&EntityUpdater<StubEntity>::updateClimate, states);
+}
+
+void Benchmarks::updateSwitch() {
+    EntityState states[2];
+    switchStates(states);
+    QVERIFY(changedValues(&EntityUpdater<StubEntity>::updateSwitch, states) > 0);
+    benchmarkUpdate(&EntityUpdater<StubEntity>::updateSwitch, states);
+}
+
+void Benchmarks::supportedFeatures() {
+    // the feature lists of an entity registration, climate with its HVAC modes
+    const int CLIMATE_FEATURES =
+        ClimateFeatures::SUPPORT_TARGET_TEMPERATURE | ClimateFeatures::SUPPORT_TURN_OFF |
+        ((HvacModes::MODE_OFF | HvacModes::MODE_HEAT | HvacModes::MODE_COOL) << HvacModes::HVAC_MODES_SHIFT);
+    FeatureMapper mapper;
+    QCOMPARE(mapper.features("light", LightFeatures::SUPPORT_BRIGHTNESS | LightFeatures::SUPPORT_COLOR),
+             QStringList({"BRIGHTNESS", "COLOR"}));
+    QVERIFY(mapper.features("climate", CLIMATE_FEATURES).contains("HEAT"));
+
+    QBENCHMARK {
+        mapper.features("light", 44);
+        mapper.features("blind", 15);
+        mapper.features("media_player", 4127295);
+        mapper.features("climate", CLIMATE_FEATURES);
+        mapper.features("switch", 0);
+    }
+}
+
+void Benchmarks::findRemoteCodes() {
+    // the remote returns the same shared command list as long as it is not changed, one button is not mapped
+    const char  *FEATURES[] = {"VOLUME_UP", "VOLUME_DOWN", "CHANNEL_UP", "CURSOR_OK", "DIGIT_7", "RECORD"};
+    QVariantList commands = remoteCommands();
+    RemoteIndex  index;
+    index.build(commands);
+    const RemoteCode *code = index.find(commands, "VOLUME_UP");
+    QVERIFY(code);
+    QCOMPARE(code->device, QString("living_room_tv"));
+    QCOMPARE(code->codes.length(), 4);
+    QVERIFY(!index.find(commands, "RECORD"));
+
+    QVector<QString> features;
+    for (const char *feature : FEATURES) {
+        features.append(feature);
+    }
+    QBENCHMARK {
+        for (int i = 0; i < features.length(); i++) {
+            index.find(commands, features[i]);
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(Benchmarks)
+
+#include "tst_benchmarks.moc"
@@ -0,0 +1,24 @@
+# Plugin sources which only depend on Qt core: the message decoding and serialization, request tracking, statistics,
+# the feature tables and the remote index. The entity updater is a header template which only uses the entity
+# definitions of the integrations.library headers, the integration itself is not part of the test targets.
+INCLUDEPATH += $$PWD/../src
+
+HEADERS += $$PWD/../src/homeassistant_decoder.h \
+           $$PWD/../src/homeassistant_entityupdater.h \
+           $$PWD/../src/homeassistant_jsonreader.h \
+           $$PWD/../src/homeassistant_latency.h \
+           $$PWD/../src/homeassistant_profiler.h \
+           $$PWD/../src/homeassistant_remoteindex.h \
+           $$PWD/../src/homeassistant_requests.h \
+           $$PWD/../src/homeassistant_sendqueue.h \
+           $$PWD/../src/homeassistant_serializer.h \
+           $$PWD/../src/homeassistant_supportedfeatures.h
+SOURCES += $$PWD/../src/homeassistant_decoder.cpp \
+           $$PWD/../src/homeassistant_jsonreader.cpp \
+           $$PWD/../src/homeassistant_latency.cpp \
+           $$PWD/../src/homeassistant_profiler.cpp \
+           $$PWD/../src/homeassistant_remoteindex.cpp \
+           $$PWD/../src/homeassistant_requests.cpp \
+           $$PWD/../src/homeassistant_sendqueue.cpp \
+           $$PWD/../src/homeassistant_serializer.cpp \
+           $$PWD/../src/homeassistant_supportedfeatures.cpp
@@ -0,0 +1,7 @@
+# Location of the integrations.library project, resolved like in homeassistant.pro
+INTG_LIB_PATH = $$(YIO_SRC)
+isEmpty(INTG_LIB_PATH) {
+    INTG_LIB_PATH = $$clean_path($$PWD/../../integrations.library)
+} else {
+    INTG_LIB_PATH = $$(YIO_SRC)/integrations.library
+}
@@ -0,0 +1,344 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QVariantMap>
+#include <functional>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "homeassistant.h"
+#include "homeassistant_latency.h"
+#include "homeassistant_profiler.h"
+#include "mockhomeassistant.h"
+#include "stubs.h"
+
+namespace {
+const QString TOKEN = QStringLiteral("replay-token");
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+const Qt::SplitBehavior SKIP_EMPTY_PARTS = Qt::SkipEmptyParts;
+#else
+const QString::SplitBehavior SKIP_EMPTY_PARTS = QString::SkipEmptyParts;
+#endif
+
+/**
+ * @brief Processes events until the condition is met, returns false on timeout
+ */
+bool waitFor(const std::function<bool()> &condition, int timeout) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!condition()) {
+        if (timer.hasExpired(timeout)) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+    }
+    return true;
+}
+
+void run(int ms) {
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+// peak resident set size in kB, not available on Windows
+qint64 peakRss() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return static_cast<qint64>(usage.ru_maxrss) / 1024;
+#else
+        return static_cast<qint64>(usage.ru_maxrss);
+#endif
+    }
+#endif
+    return -1;
+}
+
+/**
+ * @brief Toggles lights through the integration and measures the time until the light reports its new state: the
+ * command round trip through the send queue, the mock server, the decoder and the entity update
+ */
+class CommandProbe {
+ public:
+    void send(HomeAssistant *integration, StubLight *light) {
+        if (m_sent.contains(light)) {
+            // the previous toggle of the light is still on its way
+            m_skipped++;
+            return;
+        }
+        m_sent[light].start();
+        integration->sendCommand("light", light->entity_id(), LightDef::C_TOGGLE, QVariant());
+    }
+
+    void onState(StubLight *light) {
+        QHash<StubLight *, QElapsedTimer>::iterator iter = m_sent.find(light);
+        if (iter == m_sent.end()) {
+            return;
+        }
+        qint64 ns = iter->nsecsElapsed();
+        m_rtt.record(ns / 1000000);
+        m_totalNs += ns;
+        m_sent.erase(iter);
+    }
+
+    void reset() {
+        m_sent.clear();
+        m_rtt = LatencyHistogram();
+        m_totalNs = 0;
+        m_skipped = 0;
+    }
+
+    QVariantMap statistics() const {
+        QVariantMap statistics = m_rtt.toVariant();
+        statistics.insert("mean_us", m_rtt.count() > 0 ? m_totalNs / 1000 / static_cast<qint64>(m_rtt.count()) : 0);
+        statistics.insert("unanswered", m_sent.size());
+        statistics.insert("skipped", m_skipped);
+        return statistics;
+    }
+
+ private:
+    QHash<StubLight *, QElapsedTimer> m_sent;
+    LatencyHistogram                  m_rtt;
+    qint64                            m_totalNs = 0;
+    int                               m_skipped = 0;
+};
+
+QVariantMap serverStatistics(MockHomeAssistant *server) {
+    QVariantMap statistics;
+    QMetaObject::invokeMethod(server, "statistics", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(QVariantMap, statistics));
+    return statistics;
+}
+
+quint64 entityUpdates(const QList<StubLight *> &lights) {
+    quint64 updates = 0;
+    for (int i = 0; i < lights.length(); i++) {
+        updates += lights[i]->updates();
+    }
+    return updates;
+}
+}  // namespace
+
+/**
+ * @brief Runs the integration against a mock Home Assistant on the loopback interface. For each event rate the mock
+ * streams state changes while the lights are toggled through the integration, the throughput, CPU time per message,
+ * peak RSS and the command round trip time are printed as JSON.
+ */
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("homeassistant-replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs the Home Assistant integration against a local mock server.");
+    parser.addHelpOption();
+    QCommandLineOption lightsOption("lights", "Number of configured lights.", "count", "100");
+    QCommandLineOption ratesOption("rates", "Comma separated event rates per second, one pass each.", "rates",
+                                   "10,100,1000");
+    QCommandLineOption durationOption("duration", "Duration of each pass in seconds.", "seconds", "10");
+    QCommandLineOption commandsOption("commands", "Toggle commands per second.", "rate", "5");
+    QCommandLineOption captureOption("capture", "Replays the events of a capture file (see the capture_file option) "
+                                                "instead of synthetic brightness changes.", "file");
+    QCommandLineOption stateChangedOption("state-changed", "Subscribes to state_changed instead of subscribe_entities.");
+    QCommandLineOption noDecodeThreadOption("no-decode-thread", "Decodes the messages on the integration thread.");
+    QCommandLineOption verboseOption("verbose", "Shows the debug log of the integration.");
+    parser.addOptions({lightsOption, ratesOption, durationOption, commandsOption, captureOption, stateChangedOption,
+                       noDecodeThreadOption, verboseOption});
+    parser.process(app);
+
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules("*.debug=false");
+    }
+    int        lightCount = qMax(1, parser.value(lightsOption).toInt());
+    int        duration = qMax(1, parser.value(durationOption).toInt()) * 1000;
+    int        commandRate = qMax(0, parser.value(commandsOption).toInt());
+    QList<int> rates;
+    for (const QString &rate : parser.value(ratesOption).split(',', SKIP_EMPTY_PARTS)) {
+        rates.append(qMax(0, rate.trimmed().toInt()));
+    }
+
+    QTextStream err(stderr);
+    QStringList capture;
+    if (parser.isSet(captureOption)) {
+        QFile file(parser.value(captureOption));
+        if (!file.open(QIODevice::ReadOnly)) {
+            err << "Cannot open capture file " << file.fileName() << ": " << file.errorString() << '\n';
+            return 1;
+        }
+        // one frame per line, only the events of a subscription are replayed
+        while (!file.atEnd()) {
+            QString frame = QString::fromUtf8(file.readLine().trimmed());
+            if (frame.startsWith("{\"id\":") && frame.contains("\"type\":\"event\"")) {
+                capture.append(frame);
+            }
+        }
+    }
+
+    // the server has its own thread, the integration runs on this one like on its plugin thread
+    QThread            serverThread;
+    MockHomeAssistant *server = new MockHomeAssistant(lightCount, TOKEN);
+    server->moveToThread(&serverThread);
+    QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread.start();
+    quint16 port = 0;
+    QMetaObject::invokeMethod(server, "listen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(quint16, port));
+    if (port == 0) {
+        err << "Cannot listen on the loopback interface\n";
+        serverThread.quit();
+        serverThread.wait();
+        return 1;
+    }
+    if (!capture.isEmpty()) {
+        QMetaObject::invokeMethod(server, "setCapture", Qt::QueuedConnection, Q_ARG(QStringList, capture));
+    }
+
+    CommandProbe       probe;
+    StubEntities       entities;
+    StubNotifications  notifications;
+    QList<StubLight *> lights;
+    for (int i = 0; i < lightCount; i++) {
+        StubLight *light = new StubLight(MockHomeAssistant::lightId(i), "homeassistant-replay",
+                                         [&probe](StubLight *light, int state) {
+                                             Q_UNUSED(state)
+                                             probe.onState(light);
+                                         });
+        lights.append(light);
+        entities.addLight(light);
+    }
+
+    QVariantMap data;
+    data.insert(Integration::KEY_DATA_IP, QString("127.0.0.1:%1").arg(port));
+    data.insert(Integration::KEY_DATA_TOKEN, TOKEN);
+    data.insert("compact_updates", !parser.isSet(stateChangedOption));
+    data.insert("decode_thread", !parser.isSet(noDecodeThreadOption));
+    data.insert("state_snapshot", false);
+    data.insert("artwork_size", 0);
+    QVariantMap config;
+    config.insert(Integration::KEY_ID, "homeassistant-replay");
+    config.insert(Integration::KEY_FRIENDLYNAME, "Replay");
+    config.insert(Integration::OBJ_DATA, data);
+
+    HomeAssistantPlugin plugin;
+    HomeAssistant      *integration = new HomeAssistant(config, &entities, &notifications, nullptr, nullptr, &plugin);
+    QElapsedTimer       connectTimer;
+    connectTimer.start();
+    integration->connect();
+
+    // connected once every light got its state
+    bool connected = waitFor(
+        [&lights]() {
+            for (int i = 0; i < lights.length(); i++) {
+                if (lights[i]->updates() == 0) {
+                    return false;
+                }
+            }
+            return true;
+        },
+        30000);
+    qint64 connectTime = connectTimer.elapsed();
+
+    QVariantList passes;
+    if (connected) {
+        int    nextLight = 0;
+        QTimer commandTimer;
+        QObject::connect(&commandTimer, &QTimer::timeout, [&]() {
+            probe.send(integration, lights[nextLight]);
+            nextLight = (nextLight + 1) % lights.length();
+        });
+
+        for (int i = 0; i < rates.length(); i++) {
+            probe.reset();
+            QVariantMap serverBefore = serverStatistics(server);
+            quint64     updatesBefore = entityUpdates(lights);
+            qint64      cpuStart = Profiler::threadCpuTime();
+            QElapsedTimer timer;
+            timer.start();
+
+            QMetaObject::invokeMethod(server, "setEventRate", Qt::QueuedConnection, Q_ARG(int, rates[i]));
+            if (commandRate > 0) {
+                commandTimer.start(qMax(1, 1000 / commandRate));
+            }
+            run(duration);
+            commandTimer.stop();
+            QMetaObject::invokeMethod(server, "setEventRate", Qt::QueuedConnection, Q_ARG(int, 0));
+            // the messages still in flight are processed
+            run(500);
+
+            qint64      elapsed = qMax(timer.nsecsElapsed(), Q_INT64_C(1));
+            qint64      cpu = Profiler::threadCpuTime() - cpuStart;
+            QVariantMap serverAfter = serverStatistics(server);
+            quint64     frames = serverAfter.value("frames").toULongLong() - serverBefore.value("frames").toULongLong();
+            quint64     events = serverAfter.value("events").toULongLong() - serverBefore.value("events").toULongLong();
+
+            QVariantMap pass;
+            pass.insert("event_rate", rates[i]);
+            pass.insert("events", events);
+            pass.insert("messages", frames);
+            pass.insert("messages_per_second", static_cast<double>(frames) * 1e9 / elapsed);
+            pass.insert("cpu_ns_per_message", frames > 0 ? cpu / static_cast<qint64>(frames) : 0);
+            pass.insert("entity_updates", entityUpdates(lights) - updatesBefore);
+            pass.insert("command_rtt", probe.statistics());
+            passes.append(pass);
+        }
+    } else {
+        err << "Not connected to the mock server within 30 s\n";
+    }
+
+    QVariantMap report;
+    report.insert("lights", lightCount);
+    report.insert("compact_updates", !parser.isSet(stateChangedOption));
+    report.insert("decode_thread", !parser.isSet(noDecodeThreadOption));
+    report.insert("capture_frames", capture.length());
+    report.insert("connected", connected);
+    report.insert("connect_ms", connectTime);
+    report.insert("passes", passes);
+    report.insert("peak_rss_kb", peakRss());
+    report.insert("server", serverStatistics(server));
+    report.insert("updates", integration->updateStatistics());
+    report.insert("latency", integration->latencyStatistics());
+    report.insert("send_queue", integration->sendQueueStatistics());
+    report.insert("available_entities", entities.availableEntities());
+    report.insert("notifications", notifications.texts());
+
+    integration->disconnect();
+    delete integration;
+    qDeleteAll(lights);
+    serverThread.quit();
+    serverThread.wait();
+
+    QTextStream out(stdout);
+    out << QJsonDocument::fromVariant(report).toJson(QJsonDocument::Indented);
+    return connected ? 0 : 1;
+}
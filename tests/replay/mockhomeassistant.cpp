@@ -0,0 +1,303 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "mockhomeassistant.h"
+
+#include <QDateTime>
+#include <QHostAddress>
+#include <QJsonDocument>
+
+namespace {
+const char *HA_VERSION = "2024.10.0";
+
+QString isoTime(qint64 msecs) {
+    // the format of Home Assistant with microseconds
+    return QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC).toString("yyyy-MM-ddTHH:mm:ss.zzz") + "000+00:00";
+}
+
+QString seconds(qint64 msecs) { return QString::number(msecs / 1000.0, 'f', 3); }
+
+QString stateOf(bool on) { return on ? QStringLiteral("on") : QStringLiteral("off"); }
+}  // namespace
+
+MockHomeAssistant::MockHomeAssistant(int lights, const QString &token) : m_token(token) {
+    m_lights.resize(lights);
+    for (int i = 0; i < lights; i++) {
+        m_lights[i].id = lightId(i);
+        m_lights[i].lastUpdated = timestamp();
+    }
+}
+
+quint16 MockHomeAssistant::listen() {
+    m_server = new QWebSocketServer(QStringLiteral("mock-homeassistant"), QWebSocketServer::NonSecureMode, this);
+    if (!m_server->listen(QHostAddress::LocalHost)) {
+        return 0;
+    }
+    QObject::connect(m_server, &QWebSocketServer::newConnection, this, &MockHomeAssistant::onNewConnection);
+
+    m_eventTimer = new QTimer(this);
+    m_eventTimer->setInterval(10);
+    QObject::connect(m_eventTimer, &QTimer::timeout, this, &MockHomeAssistant::onEventTimer);
+    return m_server->serverPort();
+}
+
+void MockHomeAssistant::setEventRate(int eventsPerSecond) {
+    m_eventRate = eventsPerSecond;
+    m_eventsDue = 0;
+    m_eventClock.start();
+    if (m_eventRate > 0) {
+        m_eventTimer->start();
+    } else {
+        m_eventTimer->stop();
+    }
+}
+
+void MockHomeAssistant::setCapture(const QStringList &frames) {
+    m_capture = frames;
+    m_nextCaptureFrame = 0;
+}
+
+QVariantMap MockHomeAssistant::statistics() const {
+    QVariantMap statistics;
+    statistics.insert("connections", m_connections);
+    statistics.insert("frames", m_sentFrames);
+    statistics.insert("events", m_sentEvents);
+    statistics.insert("service_calls", m_serviceCalls);
+    statistics.insert("pings", m_pings);
+    statistics.insert("compact", m_compact);
+    return statistics;
+}
+
+void MockHomeAssistant::onNewConnection() {
+    QWebSocket *client = m_server->nextPendingConnection();
+    if (m_client) {
+        m_client->abort();
+        m_client->deleteLater();
+    }
+    m_client = client;
+    m_subscriptionId = 0;
+    m_connections++;
+    QObject::connect(client, &QWebSocket::textMessageReceived, this, &MockHomeAssistant::onTextMessageReceived);
+    QObject::connect(client, &QWebSocket::disconnected, this, [this, client]() {
+        if (m_client == client) {
+            m_client = nullptr;
+            m_subscriptionId = 0;
+        }
+        client->deleteLater();
+    });
+    m_client->sendTextMessage(QString("{\"type\":\"auth_required\",\"ha_version\":\"%1\"}").arg(HA_VERSION));
+    m_sentFrames++;
+}
+
+void MockHomeAssistant::onTextMessageReceived(const QString &message) {
+    QVariantMap map = QJsonDocument::fromJson(message.toUtf8()).toVariant().toMap();
+    QString     type = map.value("type").toString();
+    int         id = map.value("id").toInt();
+
+    if (type == "auth") {
+        if (map.value("access_token").toString() == m_token) {
+            m_client->sendTextMessage(QString("{\"type\":\"auth_ok\",\"ha_version\":\"%1\"}").arg(HA_VERSION));
+        } else {
+            m_client->sendTextMessage("{\"type\":\"auth_invalid\",\"message\":\"Invalid access token or password\"}");
+        }
+        m_sentFrames++;
+    } else if (type == "ping") {
+        m_pings++;
+        m_client->sendTextMessage(QString("{\"id\":%1,\"type\":\"pong\"}").arg(id));
+        m_sentFrames++;
+    } else if (type == "call_service") {
+        callService(id, map);
+    } else if (type == "get_states") {
+        QString states = "[";
+        for (int i = 0; i < m_lights.length(); i++) {
+            if (i > 0) {
+                states.append(',');
+            }
+            states.append(fullState(m_lights[i]));
+        }
+        states.append(']');
+        sendResult(id, true, states);
+    } else if (type == "subscribe_events") {
+        m_subscriptionId = id;
+        m_compact = false;
+        sendResult(id, true);
+    } else if (type == "subscribe_entities") {
+        m_subscriptionId = id;
+        m_compact = true;
+        QStringList entityIds = map.value("entity_ids").toStringList();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        m_compactEntities = QSet<QString>(entityIds.begin(), entityIds.end());
+#else
+        m_compactEntities = entityIds.toSet();
+#endif
+        sendResult(id, true);
+
+        // the initial state of the subscribed entities
+        QString added;
+        for (int i = 0; i < m_lights.length(); i++) {
+            if (!m_compactEntities.contains(m_lights[i].id)) {
+                continue;
+            }
+            if (!added.isEmpty()) {
+                added.append(',');
+            }
+            added.append(QString("\"%1\":%2").arg(m_lights[i].id, compactState(m_lights[i])));
+        }
+        m_client->sendTextMessage(QString("{\"id\":%1,\"type\":\"event\",\"event\":{\"a\":{%2}}}").arg(id).arg(added));
+        m_sentFrames++;
+    } else if (type == "unsubscribe_events") {
+        if (map.value("subscription").toInt() == m_subscriptionId) {
+            m_subscriptionId = 0;
+        }
+        sendResult(id, true);
+    } else if (type == "supported_features") {
+        sendResult(id, true);
+    } else {
+        m_client->sendTextMessage(QString("{\"id\":%1,\"type\":\"result\",\"success\":false,\"error\":{\"code\":"
+                                          "\"unknown_command\",\"message\":\"Unknown command.\"}}")
+                                      .arg(id));
+        m_sentFrames++;
+    }
+}
+
+void MockHomeAssistant::callService(int id, const QVariantMap &message) {
+    m_serviceCalls++;
+    QString service = message.value("service").toString();
+    QString entityId = message.value("service_data").toMap().value("entity_id").toString();
+    bool    ok = false;
+    int     index = entityId.mid(entityId.lastIndexOf('_') + 1).toInt(&ok);
+    if (message.value("domain").toString() != "light" || !ok || index < 0 || index >= m_lights.length() ||
+        m_lights[index].id != entityId) {
+        m_client->sendTextMessage(QString("{\"id\":%1,\"type\":\"result\",\"success\":false,\"error\":{\"code\":"
+                                          "\"not_found\",\"message\":\"Entity not found.\"}}")
+                                      .arg(id));
+        m_sentFrames++;
+        return;
+    }
+
+    Light &light = m_lights[index];
+    Light  previous = light;
+    if (service == "turn_on") {
+        light.on = true;
+    } else if (service == "turn_off") {
+        light.on = false;
+    } else if (service == "toggle") {
+        light.on = !light.on;
+    }
+    light.lastUpdated = timestamp();
+    sendResult(id, true, QString("{\"context\":{\"id\":\"%1\",\"parent_id\":null,\"user_id\":null}}")
+                             .arg(light.lastUpdated, 0, 16));
+    sendStateChange(previous, light);
+}
+
+void MockHomeAssistant::onEventTimer() {
+    if (!m_client || m_subscriptionId == 0 || m_lights.isEmpty()) {
+        return;
+    }
+
+    // events which are due since the rate was set, a late timer catches up
+    qint64 due = m_eventClock.elapsed() * m_eventRate / 1000;
+    for (; m_eventsDue < due; m_eventsDue++) {
+        if (!m_capture.isEmpty()) {
+            // the recorded subscription id is replaced by the current one
+            const QString &frame = m_capture[m_nextCaptureFrame];
+            m_nextCaptureFrame = (m_nextCaptureFrame + 1) % m_capture.length();
+            m_client->sendTextMessage(QString("{\"id\":%1").arg(m_subscriptionId) + frame.mid(frame.indexOf(',')));
+            m_sentFrames++;
+            m_sentEvents++;
+            continue;
+        }
+
+        Light &light = m_lights[m_nextLight];
+        m_nextLight = (m_nextLight + 1) % m_lights.length();
+        if (m_compact && !m_compactEntities.contains(light.id)) {
+            continue;
+        }
+        Light previous = light;
+        light.brightness = light.brightness % 254 + 1;
+        light.lastUpdated = timestamp();
+        sendStateChange(previous, light);
+    }
+}
+
+void MockHomeAssistant::sendResult(int id, bool success, const QString &result) {
+    m_client->sendTextMessage(QString("{\"id\":%1,\"type\":\"result\",\"success\":%2,\"result\":%3}")
+                                  .arg(id)
+                                  .arg(success ? "true" : "false")
+                                  .arg(result));
+    m_sentFrames++;
+}
+
+void MockHomeAssistant::sendStateChange(const Light &previous, const Light &light) {
+    if (!m_client || m_subscriptionId == 0) {
+        return;
+    }
+
+    QString frame;
+    if (m_compact) {
+        if (!m_compactEntities.contains(light.id)) {
+            return;
+        }
+        // only the changed fields
+        QString diff = QString("\"a\":{\"brightness\":%1},\"lu\":%2,\"c\":\"%3\"")
+                           .arg(light.brightness)
+                           .arg(seconds(light.lastUpdated))
+                           .arg(light.lastUpdated, 0, 16);
+        if (light.on != previous.on) {
+            diff.prepend(QString("\"s\":\"%1\",").arg(stateOf(light.on)));
+        }
+        frame = QString("{\"id\":%1,\"type\":\"event\",\"event\":{\"c\":{\"%2\":{\"+\":{%3}}}}}")
+                    .arg(m_subscriptionId)
+                    .arg(light.id, diff);
+    } else {
+        frame = QString("{\"id\":%1,\"type\":\"event\",\"event\":{\"event_type\":\"state_changed\",\"data\":{"
+                        "\"entity_id\":\"%2\",\"old_state\":%3,\"new_state\":%4},\"origin\":\"LOCAL\","
+                        "\"time_fired\":\"%5\",\"context\":{\"id\":\"%6\",\"parent_id\":null,\"user_id\":null}}}")
+                    .arg(m_subscriptionId)
+                    .arg(light.id, fullState(previous), fullState(light), isoTime(light.lastUpdated),
+                         QString::number(light.lastUpdated, 16));
+    }
+    m_client->sendTextMessage(frame);
+    m_sentFrames++;
+    m_sentEvents++;
+}
+
+QString MockHomeAssistant::fullState(const Light &light) const {
+    QString time = isoTime(light.lastUpdated);
+    return QString("{\"entity_id\":\"%1\",\"state\":\"%2\",\"attributes\":{\"supported_color_modes\":["
+                   "\"brightness\"],\"color_mode\":\"brightness\",\"brightness\":%3,\"friendly_name\":\"Mock %1\","
+                   "\"supported_features\":1},\"last_changed\":\"%4\",\"last_updated\":\"%4\",\"context\":{"
+                   "\"id\":\"%5\",\"parent_id\":null,\"user_id\":null}}")
+        .arg(light.id, stateOf(light.on), QString::number(light.brightness), time,
+             QString::number(light.lastUpdated, 16));
+}
+
+QString MockHomeAssistant::compactState(const Light &light) const {
+    return QString("{\"s\":\"%1\",\"a\":{\"supported_color_modes\":[\"brightness\"],\"color_mode\":\"brightness\","
+                   "\"brightness\":%2,\"friendly_name\":\"Mock %3\",\"supported_features\":1},\"c\":\"%4\","
+                   "\"lc\":%5}")
+        .arg(stateOf(light.on), QString::number(light.brightness), light.id,
+             QString::number(light.lastUpdated, 16), seconds(light.lastUpdated));
+}
+
+qint64 MockHomeAssistant::timestamp() {
+    m_lastTimestamp = qMax(QDateTime::currentMSecsSinceEpoch(), m_lastTimestamp + 1);
+    return m_lastTimestamp;
+}
@@ -0,0 +1,108 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVariant>
+#include <QVector>
+#include <QtWebSockets/QWebSocket>
+#include <QtWebSockets/QWebSocketServer>
+
+/**
+ * @brief Home Assistant websocket API on the loopback interface: authentication, get_states, subscribe_events,
+ * subscribe_entities, call_service and ping. Events are sent at the configured rate per second: the lights change their
+ * brightness, or the event frames of a capture are replayed for the current subscription. A call_service result is
+ * followed by the state change of the light. Lives on its own thread, it is controlled with queued calls.
+ */
+class MockHomeAssistant : public QObject {
+    Q_OBJECT
+
+ public:
+    MockHomeAssistant(int lights, const QString& token);
+
+    static QString lightId(int index) { return QString("light.mock_%1").arg(index); }
+
+    /**
+     * @brief Starts listening on a free port of the loopback interface and returns it, 0 on failure
+     */
+    Q_INVOKABLE quint16 listen();
+
+    /**
+     * @brief Sets the rate of the synthetic brightness changes, 0 stops them
+     */
+    Q_INVOKABLE void setEventRate(int eventsPerSecond);
+
+    /**
+     * @brief Replays the given event frames in a loop instead of the synthetic brightness changes
+     */
+    Q_INVOKABLE void setCapture(const QStringList& frames);
+
+    Q_INVOKABLE QVariantMap statistics() const;
+
+ private:
+    struct Light {
+        QString id;
+        bool    on = false;
+        int     brightness = 128;
+        qint64  lastUpdated = 0;
+    };
+
+    void onNewConnection();
+    void onTextMessageReceived(const QString& message);
+    void onEventTimer();
+
+    void sendResult(int id, bool success, const QString& result = "null");
+    void sendStateChange(const Light& previous, const Light& light);
+    void callService(int id, const QVariantMap& message);
+
+    QString fullState(const Light& light) const;
+    QString compactState(const Light& light) const;
+    // milliseconds since the epoch, unique and increasing
+    qint64 timestamp();
+
+    QString           m_token;
+    QWebSocketServer* m_server = nullptr;
+    QWebSocket*       m_client = nullptr;
+    QVector<Light>    m_lights;
+    int               m_subscriptionId = 0;
+    bool              m_compact = false;
+    QSet<QString>     m_compactEntities;
+    qint64            m_lastTimestamp = 0;
+
+    QTimer*       m_eventTimer = nullptr;
+    QElapsedTimer m_eventClock;
+    int           m_eventRate = 0;
+    qint64        m_eventsDue = 0;
+    int           m_nextLight = 0;
+    QStringList   m_capture;
+    int           m_nextCaptureFrame = 0;
+
+    quint64 m_sentEvents = 0;
+    quint64 m_sentFrames = 0;
+    quint64 m_serviceCalls = 0;
+    quint64 m_pings = 0;
+    quint64 m_connections = 0;
+};
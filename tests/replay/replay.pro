@@ -0,0 +1,33 @@
+TEMPLATE  = app
+TARGET    = homeassistant-replay
+CONFIG   += c++14 console
+CONFIG   -= app_bundle
+QT       += core network websockets quick concurrent
+
+DEFINES  += PLUGIN_VERSION=\\\"replay\\\"
+
+include(../homeassistant-core.pri)
+
+# the integration is built in with the plugin library of integrations.library
+include(../integrations-library.pri)
+! include($$INTG_LIB_PATH/yio-plugin-lib.pri) {
+    error( "Cannot find the yio-plugin-lib.pri file!" )
+}
+
+# homeassistant.json of the plugin metadata is searched next to this project
+INCLUDEPATH += $$PWD
+
+HEADERS  += $$PWD/../../src/homeassistant.h \
+            $$PWD/../../src/homeassistant_artwork.h \
+            $$PWD/../../src/homeassistant_decodeworker.h \
+            $$PWD/../../src/homeassistant_dialer.h \
+            $$PWD/../../src/homeassistant_snapshot.h \
+            mockhomeassistant.h \
+            stubs.h
+SOURCES  += $$PWD/../../src/homeassistant.cpp \
+            $$PWD/../../src/homeassistant_artwork.cpp \
+            $$PWD/../../src/homeassistant_decodeworker.cpp \
+            $$PWD/../../src/homeassistant_dialer.cpp \
+            $$PWD/../../src/homeassistant_snapshot.cpp \
+            main.cpp \
+            mockhomeassistant.cpp
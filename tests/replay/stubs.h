@@ -0,0 +1,184 @@
+/******************************************************************************
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <functional>
+
+#include "yio-interface/entities/entitiesinterface.h"
+#include "yio-interface/entities/entityinterface.h"
+#include "yio-interface/entities/lightinterface.h"
+#include "yio-interface/notificationsinterface.h"
+
+/**
+ * @brief A light of the remote without UI: keeps the pushed state and attributes and reports state changes to the
+ * harness
+ */
+class StubLight : public EntityInterface {
+ public:
+    typedef std::function<void(StubLight* light, int state)> StateListener;
+
+    StubLight(const QString& entityId, const QString& integration, const StateListener& listener)
+        : m_entityId(entityId), m_integration(integration), m_listener(listener) {}
+
+    QString      type() { return QStringLiteral("light"); }
+    QString      entity_id() { return m_entityId; }
+    QString      area() { return QString(); }
+    QString      friendly_name() { return m_entityId; }
+    QString      integration() { return m_integration; }
+    QObject*     integrationObj() { return nullptr; }
+    QStringList  supported_features() { return QStringList({"BRIGHTNESS"}); }
+    QVariant     custom_features() { return QVariant(); }
+    bool         favorite() { return false; }
+    void         setFavorite(bool value) { Q_UNUSED(value) }
+    int          state() { return m_state; }
+    QString      stateText() { return stateAsString(); }
+    QString      stateAsString() { return m_state == LightDef::ON ? QStringLiteral("ON") : QStringLiteral("OFF"); }
+    bool         isOn() { return m_state == LightDef::ON; }
+    bool         isSupported(int feature) { return feature == LightDef::F_BRIGHTNESS; }
+    QString      getCommandName(int command) { return QString::number(command); }
+    int          getCommandIndex(const QString& command) { return command.toInt(); }
+    void*        getSpecificInterface() { return nullptr; }
+    bool         update(const QVariantMap& attributes) {
+        Q_UNUSED(attributes)
+        return false;
+    }
+    bool updateAttrByName(const QString& attrName, const QVariant& value) {
+        Q_UNUSED(attrName)
+        Q_UNUSED(value)
+        return false;
+    }
+
+    bool setState(int state) {
+        m_state = state;
+        m_updates++;
+        if (m_listener) {
+            m_listener(this, state);
+        }
+        return true;
+    }
+
+    bool updateAttrByIndex(int attrIndex, const QVariant& value) {
+        m_attributes.insert(attrIndex, value);
+        m_updates++;
+        return true;
+    }
+
+    quint64 updates() const { return m_updates; }
+
+ private:
+    QString              m_entityId;
+    QString              m_integration;
+    StateListener        m_listener;
+    int                  m_state = LightDef::OFF;
+    QHash<int, QVariant> m_attributes;
+    quint64              m_updates = 0;
+};
+
+/**
+ * @brief The entities of the remote: the configured lights of the integration, registered available entities are only
+ * counted
+ */
+class StubEntities : public EntitiesInterface {
+ public:
+    void addLight(StubLight* light) { m_lights.append(light); }
+
+    QList<EntityInterface*> getAll() { return m_lights; }
+    QList<EntityInterface*> getByType(const QString& type) {
+        return type == QLatin1String("light") ? m_lights : QList<EntityInterface*>();
+    }
+    QList<EntityInterface*> getByIntegration(const QString& integration) {
+        Q_UNUSED(integration)
+        return m_lights;
+    }
+    QObject*         get(const QString& entity_id) {
+        Q_UNUSED(entity_id)
+        return nullptr;
+    }
+    EntityInterface* getEntityInterface(const QString& entity_id) {
+        for (int i = 0; i < m_lights.length(); i++) {
+            if (m_lights[i]->entity_id() == entity_id) {
+                return m_lights[i];
+            }
+        }
+        return nullptr;
+    }
+    void add(const QString& type, const QVariantMap& config, QObject* integrationObj) {
+        Q_UNUSED(type)
+        Q_UNUSED(config)
+        Q_UNUSED(integrationObj)
+    }
+    void update(const QString& entity_id, const QVariantMap& attributes) {
+        Q_UNUSED(entity_id)
+        Q_UNUSED(attributes)
+    }
+    QStringList supported_entities() { return QStringList({"light"}); }
+    QStringList supported_entities_translation() { return supported_entities(); }
+    QStringList loaded_entities() { return supported_entities(); }
+    void        addLoadedEntity(const QString& entity) { Q_UNUSED(entity) }
+    QString     getSupportedEntityTranslation(const QString& type) { return type; }
+    void        addMediaplayersPlaying(const QString& entity_id) { Q_UNUSED(entity_id) }
+    void        removeMediaplayersPlaying(const QString& entity_id) { Q_UNUSED(entity_id) }
+    void        addAvailableEntity(const QString& entity_id, const QString& type, const QString& integration,
+                                   const QString& friendly_name, const QStringList& supported_features) {
+        Q_UNUSED(entity_id)
+        Q_UNUSED(type)
+        Q_UNUSED(integration)
+        Q_UNUSED(friendly_name)
+        Q_UNUSED(supported_features)
+        m_availableEntities++;
+    }
+    void removeAvailableEntity(const QString& entity_id) { Q_UNUSED(entity_id) }
+
+    int availableEntities() const { return m_availableEntities; }
+
+ private:
+    QList<EntityInterface*> m_lights;
+    int                     m_availableEntities = 0;
+};
+
+/**
+ * @brief Collects the notifications shown to the user
+ */
+class StubNotifications : public NotificationsInterface {
+ public:
+    void add(bool error, const QString& text) {
+        Q_UNUSED(error)
+        m_texts.append(text);
+    }
+    void add(bool error, const QString& text, const QString& actionText, void (*action)(QObject*), QObject* param) {
+        Q_UNUSED(actionText)
+        Q_UNUSED(action)
+        Q_UNUSED(param)
+        add(error, text);
+    }
+    void remove(int id) { Q_UNUSED(id) }
+    void remove(const QString& text) { m_texts.removeAll(text); }
+
+    QStringList texts() const { return m_texts; }
+
+ private:
+    QStringList m_texts;
+};
@@ -0,0 +1,6 @@
+# Headless tools and tests of the plugin core, built separately from the plugin: qmake tests/tests.pro && make
+TEMPLATE = subdirs
+SUBDIRS  = benchmarks
+
+# The replay tool (replay/replay.pro) stubs the entity and notification interfaces of integrations.library and is
+# added here once it has been built against the version pinned in dependencies.cfg.